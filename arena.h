@@ -0,0 +1,114 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 8
+#define ARENA_ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+/* bump allocator, memory is only given back all at once */
+struct arena {
+	struct arena_chunk *head;
+	size_t chunk_size;
+	size_t used;		/* bytes handed out */
+	size_t allocated;	/* bytes held in chunks */
+};
+
+static inline void arena_init(struct arena *a, size_t chunk_size) {
+	a->head = NULL;
+	a->chunk_size = chunk_size;
+	a->used = 0;
+	a->allocated = 0;
+}
+
+static inline struct arena_chunk *arena_chunk_create(struct arena *a, size_t size) {
+	if(size < a->chunk_size) size = a->chunk_size;
+	struct arena_chunk *c = malloc(sizeof(struct arena_chunk) + size);
+	c->next = NULL;
+	c->size = size;
+	c->used = 0;
+	a->allocated += size;
+	return c;
+}
+
+static inline void *arena_alloc(struct arena *a, size_t size) {
+	size = ARENA_ALIGN_UP(size);
+	struct arena_chunk *c = a->head;
+	if(!c || c->used + size > c->size) {
+		struct arena_chunk *n = arena_chunk_create(a, size);
+		if(c && size > a->chunk_size) {
+			//oversized block, keep bumping in the current chunk
+			n->next = c->next;
+			c->next = n;
+			c = n;
+		} else {
+			n->next = c;
+			a->head = c = n;
+		}
+	}
+	void *p = c->data + c->used;
+	c->used += size;
+	a->used += size;
+	return p;
+}
+
+static inline char *arena_strndup(struct arena *a, const char *s, size_t l) {
+	if(!s) return NULL;
+	char *d = arena_alloc(a, l+1);
+	memcpy(d, s, l);
+	d[l] = '\0';
+	return d;
+}
+
+static inline char *arena_strdup(struct arena *a, const char *s) {
+	if(!s) return NULL;
+	return arena_strndup(a, s, strlen(s));
+}
+
+static inline char *arena_strjoin(struct arena *a, const char *s0, const char *sep, const char *s1) {
+	size_t l0 = s0 ? strlen(s0) : 0;
+	size_t l1 = sep ? strlen(sep) : 0;
+	size_t l2 = s1 ? strlen(s1) : 0;
+	char *d = arena_alloc(a, l0 + l1 + l2 + 1);
+	if(l0) memcpy(d, s0, l0);
+	if(l1) memcpy(d + l0, sep, l1);
+	if(l2) memcpy(d + l0 + l1, s1, l2);
+	d[l0 + l1 + l2] = '\0';
+	return d;
+}
+
+/* drop everything but the first chunk so the arena can be reused */
+static inline void arena_reset(struct arena *a) {
+	struct arena_chunk *c = a->head;
+	if(!c) return;
+	while(c->next) {
+		struct arena_chunk *n = c->next;
+		c->next = n->next;
+		a->allocated -= n->size;
+		free(n);
+	}
+	c->used = 0;
+	a->used = 0;
+}
+
+static inline void arena_release(struct arena *a) {
+	struct arena_chunk *c = a->head;
+	while(c) {
+		struct arena_chunk *n = c->next;
+		free(c);
+		c = n;
+	}
+	a->head = NULL;
+	a->used = 0;
+	a->allocated = 0;
+}
+
+#endif
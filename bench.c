@@ -0,0 +1,527 @@
+#include <dirent.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "fox.h"
+#include "symbol.h"
+#include "syntax.h"
+#include "source.h"
+#include "translator.h"
+
+/*
+ * fox benchmark, writes a deterministic lua corpus and times parse(),
+ * gen_chunk_symtables, translate() and the fox binary on it. when node
+ * is installed the translated returns modules are run as well: a checks
+ * module asserting the values each convention delivers, then one module
+ * per way of passing multiple return values, once as is and once with v8
+ * inlining off. an inlined callee has its arrays dropped by v8 itself.
+ * usage: fox_bench [corpus dir] [fox binary]
+ */
+
+#define BENCH_SEED 0x666f78
+#define BENCH_ROUNDS 3
+
+static uint64_t rng_state = BENCH_SEED;
+
+/* xorshift64*, the corpus must not depend on the libc rand */
+static uint32_t rng() {
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (uint32_t)((rng_state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+static int rnd(int n) {
+	return (int)(rng() % (uint32_t)n);
+}
+
+static const char *words[] = {
+	"alpha", "beta", "gamma", "delta", "sword", "shield", "potion", "arrow",
+	"quest", "dragon", "forest", "castle", "river", "stone", "flame", "frost",
+};
+#define WORDS_COUNT (sizeof(words) / sizeof(words[0]))
+
+#define BENCH_PATH_MAX 512
+
+static int join_path(char *buf, const char *dir, const char *name) {
+	int n = snprintf(buf, BENCH_PATH_MAX, "%s/%s", dir, name);
+	if(n < 0 || n >= BENCH_PATH_MAX) {
+		log_error("path too long: %.256s/%.128s", dir, name);
+		return 0;
+	}
+	return 1;
+}
+
+static void make_dir(const char *path) {
+	char cmd[BENCH_PATH_MAX + 16];
+	snprintf(cmd, sizeof(cmd), "mkdir -p %s", path);
+	system(cmd);
+}
+
+static FILE *open_lua(const char *dir, const char *name, int idx) {
+	char file[64];
+	snprintf(file, sizeof(file), "%.32s%d.lua", name, idx);
+	char path[BENCH_PATH_MAX];
+	if(!join_path(path, dir, file)) return NULL;
+	FILE *fp = fopen(path, "w");
+	if(!fp) log_error("create file failed %.256s", path);
+	return fp;
+}
+
+/* config style data, one big table of records */
+static void gen_data(FILE *fp, int rows) {
+	fprintf(fp, "local data = {\n");
+	for(int i = 0; i < rows; i++) {
+		fprintf(fp, "  { id = %d, name = \"%s_%d\", price = %d.%02d, count = %d,\n",
+				i, words[rnd(WORDS_COUNT)], i, rnd(1000), rnd(100), rnd(64));
+		fprintf(fp, "    tags = { \"%s\", \"%s\" }, pos = { x = %d, y = %d, z = %d } },\n",
+				words[rnd(WORDS_COUNT)], words[rnd(WORDS_COUNT)],
+				rnd(4096), rnd(4096), rnd(16));
+	}
+	fprintf(fp, "}\nreturn data\n");
+}
+
+/* lots of small game logic functions */
+static void gen_functions(FILE *fp, int count) {
+	for(int i = 0; i < count; i++) {
+		int k = rnd(100) + 1;
+		fprintf(fp, "local function f%d(a, b)\n", i);
+		fprintf(fp, "  local c = a * %d + b\n", k);
+		fprintf(fp, "  if c > %d then\n    return c - %d\n", k * 10, k);
+		fprintf(fp, "  elseif c < %d then\n    c = c + %d\n  end\n", k, rnd(50));
+		fprintf(fp, "  for i = 1, %d do\n    c = c + i %% %d\n  end\n", rnd(8) + 1, k);
+		fprintf(fp, "  local s = \"%s\" .. tostring(c)\n", words[rnd(WORDS_COUNT)]);
+		fprintf(fp, "  return c\nend\n\n");
+	}
+	fprintf(fp, "return f0\n");
+}
+
+static void gen_exp(FILE *fp, int depth) {
+	static const char *ops[] = { "+", "-", "*", "/", "%", "..", "==", "<", "and", "or" };
+	if(depth == 0) {
+		if(rnd(2)) fprintf(fp, "v%d", rnd(8));
+		else fprintf(fp, "%d", rnd(1000));
+		return;
+	}
+	fprintf(fp, "(");
+	gen_exp(fp, depth - 1);
+	fprintf(fp, " %s ", ops[rnd(sizeof(ops) / sizeof(ops[0]))]);
+	if(rnd(4)) gen_exp(fp, 0);
+	else {
+		fprintf(fp, "g(");
+		gen_exp(fp, depth / 2);
+		fprintf(fp, ")");
+	}
+	fprintf(fp, ")");
+}
+
+/* deeply nested expressions */
+static void gen_expressions(FILE *fp, int count, int depth) {
+	for(int i = 0; i < 8; i++) fprintf(fp, "local v%d = %d\n", i, i + 1);
+	fprintf(fp, "local function g(x)\n  return x\nend\n");
+	for(int i = 0; i < count; i++) {
+		fprintf(fp, "local e%d = ", i);
+		gen_exp(fp, depth);
+		fprintf(fp, "\n");
+	}
+}
+
+/* long comments and long strings */
+static void gen_text(FILE *fp, int blocks, int lines) {
+	for(int i = 0; i < blocks; i++) {
+		int level = rnd(3);
+		fprintf(fp, "--[%.*s[\n", level, "==");
+		for(int j = 0; j < lines; j++) {
+			fprintf(fp, "  %s %s %s, %d\n", words[rnd(WORDS_COUNT)],
+					words[rnd(WORDS_COUNT)], words[rnd(WORDS_COUNT)], j);
+		}
+		fprintf(fp, "]%.*s]\n", level, "==");
+		fprintf(fp, "local t%d = [%.*s[\n", i, level, "==");
+		for(int j = 0; j < lines; j++) {
+			fprintf(fp, "%s %s %d\n", words[rnd(WORDS_COUNT)], words[rnd(WORDS_COUNT)], j);
+		}
+		fprintf(fp, "]%.*s]\n", level, "==");
+	}
+}
+
+/* ways a two value return reaches its caller */
+enum bench_returns {
+	RETURNS_REGISTER,	/* direct local function, both values wanted */
+	RETURNS_FIRST,		/* direct local function, first value wanted */
+	RETURNS_ARRAY,		/* escaping function, both values wanted */
+	RETURNS_ARRAY_FIRST,	/* escaping function, first value wanted */
+};
+
+static const char *returns_names[] = { "register", "first", "array", "array_first" };
+#define RETURNS_COUNT (sizeof(returns_names) / sizeof(returns_names[0]))
+#define RETURNS_CALLS 10000000
+
+static void gen_returns(FILE *fp, enum bench_returns how, int calls) {
+	fprintf(fp, "local function split(a)\n  return a %% 1000 // 7, a %% 7\nend\n");
+	if(how == RETURNS_ARRAY || how == RETURNS_ARRAY_FIRST) {
+		fprintf(fp, "local keep = { split }\n");
+	}
+	fprintf(fp, "local s = 0\nfor i = 1, %d do\n", calls);
+	if(how == RETURNS_REGISTER || how == RETURNS_ARRAY) {
+		fprintf(fp, "  local q, r = split(i)\n  s = s + q + r\n");
+	} else {
+		fprintf(fp, "  s = s + split(i)\n");
+	}
+	fprintf(fp, "end\nreturn s\n");
+}
+
+/* the returns conventions checked under node: destructuring of local,
+   escaping, unknown and method callees giving 0, 1 or 2 values, a one
+   value wrapper of a library function giving two, and a one value
+   closure iterator. a failed assert makes node exit non zero */
+static const char returns_checks[] =
+	"local function g0() end\n"
+	"local function g1() return 1 end\n"
+	"local function g2() return 1, 2 end\n"
+	"local a, b = g0()\n"
+	"assert(a == nil and b == nil, \"local g0\")\n"
+	"a, b = g1()\n"
+	"assert(a == 1 and b == nil, \"local g1\")\n"
+	"a, b = g2()\n"
+	"assert(a == 1 and b == 2, \"local g2\")\n"
+	"local function e2() return 3, 4 end\n"
+	"local keep = { e2 }\n"
+	"a, b = e2()\n"
+	"assert(a == 3 and b == 4, \"escaping e2\")\n"
+	"assert(e2() == 3, \"escaping e2 first\")\n"
+	"local M = {}\n"
+	"function M.none() end\n"
+	"function M.one() return 1 end\n"
+	"function M.two() return 1, 2 end\n"
+	"function M.nil1() return nil end\n"
+	"function M.str() return \"ab\" end\n"
+	"a, b = M.none()\n"
+	"assert(a == nil and b == nil, \"unknown none\")\n"
+	"a, b = M.one()\n"
+	"assert(a == 1 and b == nil, \"unknown one\")\n"
+	"a, b = M.two()\n"
+	"assert(a == 1 and b == 2, \"unknown two\")\n"
+	"a, b = M.nil1()\n"
+	"assert(a == nil and b == nil, \"unknown nil\")\n"
+	"local c, d = M.str()\n"
+	"assert(c == \"ab\" and d == nil, \"unknown string\")\n"
+	"local t = {}\n"
+	"function t:m0() end\n"
+	"function t:m1() return 1 end\n"
+	"function t:m2() return 1, 2 end\n"
+	"a, b = t:m0()\n"
+	"assert(a == nil and b == nil, \"method m0\")\n"
+	"a, b = t:m1()\n"
+	"assert(a == 1 and b == nil, \"method m1\")\n"
+	"a, b = t:m2()\n"
+	"assert(a == 1 and b == 2, \"method m2\")\n"
+	"local o = {}\n"
+	"o.x, o.y = t:m2()\n"
+	"assert(o.x == 1 and o.y == 2, \"method m2 to fields\")\n"
+	"local function w(s) return string.find(s, \"x\") end\n"
+	"assert(w(\"axb\") == 2, \"wrapper first\")\n"
+	"local p, q = w(\"axb\")\n"
+	"assert(p == 2 and q == 2, \"wrapper both\")\n"
+	"local function iter(n)\n"
+	"  local i = 0\n"
+	"  return function() i = i + 1; if i <= n then return i end end\n"
+	"end\n"
+	"local s = 0\n"
+	"for v in iter(3) do s = s + v end\n"
+	"assert(s == 6, \"single value iterator\")\n"
+	"print(\"ok\")\n";
+
+static void gen_corpus(const char *root) {
+	char dir[BENCH_PATH_MAX];
+	FILE *fp;
+	rng_state = BENCH_SEED;
+
+	if(!join_path(dir, root, "data")) return;
+	make_dir(dir);
+	for(int i = 0; i < 4; i++) {
+		if(!(fp = open_lua(dir, "data", i))) return;
+		gen_data(fp, 10000);
+		fclose(fp);
+	}
+
+	if(!join_path(dir, root, "functions")) return;
+	make_dir(dir);
+	for(int i = 0; i < 8; i++) {
+		if(!(fp = open_lua(dir, "logic", i))) return;
+		gen_functions(fp, 2000);
+		fclose(fp);
+	}
+
+	if(!join_path(dir, root, "expressions")) return;
+	make_dir(dir);
+	for(int i = 0; i < 4; i++) {
+		if(!(fp = open_lua(dir, "exp", i))) return;
+		gen_expressions(fp, 500, 40);
+		fclose(fp);
+	}
+
+	if(!join_path(dir, root, "text")) return;
+	make_dir(dir);
+	for(int i = 0; i < 4; i++) {
+		if(!(fp = open_lua(dir, "text", i))) return;
+		gen_text(fp, 200, 40);
+		fclose(fp);
+	}
+
+	if(!join_path(dir, root, "returns")) return;
+	make_dir(dir);
+	for(size_t i = 0; i < RETURNS_COUNT; i++) {
+		if(!(fp = open_lua(dir, returns_names[i], 0))) return;
+		gen_returns(fp, (enum bench_returns)i, RETURNS_CALLS);
+		fclose(fp);
+	}
+	if(!(fp = open_lua(dir, "checks", 0))) return;
+	fputs(returns_checks, fp);
+	fclose(fp);
+
+	for(int d = 0; d < 32; d++) {
+		char mod[32];
+		snprintf(mod, sizeof(mod), "tree/mod%d", d);
+		if(!join_path(dir, root, mod)) return;
+		make_dir(dir);
+		for(int i = 0; i < 32; i++) {
+			if(!(fp = open_lua(dir, "m", i))) return;
+			gen_functions(fp, 4);
+			fclose(fp);
+		}
+	}
+}
+
+struct bench_result {
+	int files;
+	size_t bytes;
+	size_t nodes;
+	double parse;
+	double symtab;
+	double translate;
+};
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int bench_file(const char *src, const char *dest, struct bench_result *r) {
+	struct fox_source s;
+	if(!source_open(&s, src)) return 0;
+
+	struct syntax_tree *tree = NULL;
+	struct symbol_table *table = NULL;
+	double t0 = now();
+	int val = parse_tree(src, &s, &tree, &table);
+	double t1 = now();
+	if(!val) {
+		source_close(&s);
+		log_error("parse file failed:%.256s", src);
+		return 0;
+	}
+	gen_chunk_symtables(tree, (struct syntax_chunk *)tree->root);
+	double t2 = now();
+	val = translate(dest, tree, table);
+	double t3 = now();
+
+	r->files++;
+	r->bytes += s.len;
+	r->nodes += syntax_tree_node_count(tree);
+	r->parse += t1 - t0;
+	r->symtab += t2 - t1;
+	r->translate += t3 - t2;
+	syntax_tree_release(tree);
+	symbol_table_release(table);
+	source_close(&s);
+	return val;
+}
+
+static int bench_dir(const char *src, const char *dest, struct bench_result *r) {
+	DIR *dir = opendir(src);
+	if(!dir) {
+		log_error("opendir failed:%.256s", src);
+		return 0;
+	}
+	make_dir(dest);
+
+	int val = 1;
+	struct dirent *ent;
+	while(val && (ent = readdir(dir)) != NULL) {
+		if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) continue;
+		char cursrc[BENCH_PATH_MAX];
+		char curdest[BENCH_PATH_MAX];
+		if(!join_path(cursrc, src, ent->d_name) || !join_path(curdest, dest, ent->d_name)) {
+			val = 0;
+			break;
+		}
+
+		struct stat st;
+		if(stat(cursrc, &st)) continue;
+		if(S_ISDIR(st.st_mode)) {
+			val = bench_dir(cursrc, curdest, r);
+		} else {
+			char *extname = strrchr(curdest, '.');
+			if(!extname || strcmp(extname, ".lua")) continue;
+			strcpy(extname, ".js");
+			val = bench_file(cursrc, curdest, r);
+		}
+	}
+	closedir(dir);
+	return val;
+}
+
+static double mbps(size_t bytes, double t) {
+	return t > 0 ? bytes / t / (1024.0 * 1024.0) : 0;
+}
+
+static void report(const char *name, struct bench_result *r) {
+	double total = r->parse + r->symtab + r->translate;
+	printf("%-12s %6d %8.2f %10zu %9.2f %9.2f %9.2f %9.2f %12.0f\n",
+		   name, r->files, r->bytes / (1024.0 * 1024.0), r->nodes,
+		   r->parse * 1e3, r->symtab * 1e3, r->translate * 1e3,
+		   mbps(r->bytes, total), total > 0 ? r->nodes / total : 0);
+}
+
+static const char *categories[] = { "data", "functions", "expressions", "text", "tree", "returns" };
+#define CATEGORIES_COUNT (sizeof(categories) / sizeof(categories[0]))
+
+/* best of BENCH_ROUNDS runs of a shell command */
+static int bench_command(const char *cmd, double *best) {
+	for(int i = 0; i < BENCH_ROUNDS; i++) {
+		double t0 = now();
+		int val = system(cmd);
+		double t = now() - t0;
+		if(val) {
+			log_error("run failed: %.256s", cmd);
+			return 0;
+		}
+		if(!i || t < *best) *best = t;
+	}
+	return 1;
+}
+
+/* full fox runs, the cache is bypassed with -f */
+static void bench_binary(const char *fox, const char *root, const char *corpus,
+						 int njobs, size_t bytes) {
+	char cmd[BENCH_PATH_MAX * 3];
+	snprintf(cmd, sizeof(cmd), "%s -f -j %d %s %s/out_fox > /dev/null", fox, njobs, corpus, root);
+	double best = 0;
+	if(!bench_command(cmd, &best)) return;
+	printf("fox -j %-5d %8.2f ms %9.2f MB/s\n", njobs, best * 1e3, mbps(bytes, best));
+}
+
+/* best node run of a module, or of -e 0 for the startup alone */
+static int bench_node(const char *flags, const char *prelude, const char *module, double *best) {
+	char cmd[BENCH_PATH_MAX * 3];
+	snprintf(cmd, sizeof(cmd), "node %s -r %s%s %s > /dev/null",
+			 flags, prelude[0] == '/' ? "" : "./", prelude, module);
+	return bench_command(cmd, best);
+}
+
+/* each translated returns module under node, less the node startup */
+static void bench_returns(const char *root) {
+	if(system("node -v > /dev/null 2>&1")) {
+		log_warn("node not found, returns modules not run");
+		return;
+	}
+	//the modules require the runtime beside them, preloaded it is part of the startup
+	char prelude[BENCH_PATH_MAX];
+	snprintf(prelude, sizeof(prelude), "%.256s/out/returns/" FOX_RUNTIME, root);
+	FILE *fp = fopen(prelude, "w");
+	if(!fp) {
+		log_error("create file failed %.256s", prelude);
+		return;
+	}
+	fputs(fox_runtime_js, fp);
+	fclose(fp);
+
+	char cmd[BENCH_PATH_MAX * 3];
+	snprintf(cmd, sizeof(cmd), "node -r %s%s %.256s/out/returns/checks0.js > /dev/null",
+			 prelude[0] == '/' ? "" : "./", prelude, root);
+	if(system(cmd)) {
+		log_error("returns checks failed: %.256s", cmd);
+		return;
+	}
+	printf("returns checks ok\n");
+
+	static const char *noinline = "--max-inlined-bytecode-size=0";
+	double base = 0, base_noinline = 0;
+	if(!bench_node("", prelude, "-e 0", &base)) return;
+	if(!bench_node(noinline, prelude, "-e 0", &base_noinline)) return;
+
+	printf("%-12s %12s %12s %12s %12s\n", "returns", "inlined ms", "ns/call", "called ms", "ns/call");
+	for(size_t i = 0; i < RETURNS_COUNT; i++) {
+		char module[BENCH_PATH_MAX];
+		snprintf(module, sizeof(module), "%.256s/out/returns/%s0.js", root, returns_names[i]);
+		double t = 0, t_noinline = 0;
+		if(!bench_node("", prelude, module, &t)) return;
+		if(!bench_node(noinline, prelude, module, &t_noinline)) return;
+		t = t > base ? t - base : 0;
+		t_noinline = t_noinline > base_noinline ? t_noinline - base_noinline : 0;
+		printf("%-12s %12.2f %12.1f %12.2f %12.1f\n", returns_names[i],
+			   t * 1e3, t * 1e9 / RETURNS_CALLS,
+			   t_noinline * 1e3, t_noinline * 1e9 / RETURNS_CALLS);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	const char *root = argc > 1 ? argv[1] : "bench_corpus";
+	const char *fox = argc > 2 ? argv[2] : "./fox";
+	log_level = LOG_ERR;
+
+	char corpus[BENCH_PATH_MAX];
+	if(!join_path(corpus, root, "lua")) return 1;
+	gen_corpus(corpus);
+
+	printf("%-12s %6s %8s %10s %9s %9s %9s %9s %12s\n",
+		   "corpus", "files", "MB", "nodes", "parse ms", "symtab ms",
+		   "trans ms", "MB/s", "nodes/s");
+
+	struct bench_result all;
+	memset(&all, 0, sizeof(all));
+	for(size_t c = 0; c < CATEGORIES_COUNT; c++) {
+		char src[BENCH_PATH_MAX];
+		char out[BENCH_PATH_MAX];
+		char dest[BENCH_PATH_MAX];
+		if(!join_path(src, corpus, categories[c]) || !join_path(out, root, "out") ||
+		   !join_path(dest, out, categories[c])) return 1;
+
+		struct bench_result best;
+		for(int i = 0; i < BENCH_ROUNDS; i++) {
+			struct bench_result r;
+			memset(&r, 0, sizeof(r));
+			if(!bench_dir(src, dest, &r)) return 1;
+			double t = r.parse + r.symtab + r.translate;
+			if(!i || t < best.parse + best.symtab + best.translate) best = r;
+		}
+		report(categories[c], &best);
+
+		all.files += best.files;
+		all.bytes += best.bytes;
+		all.nodes += best.nodes;
+		all.parse += best.parse;
+		all.symtab += best.symtab;
+		all.translate += best.translate;
+	}
+	report("total", &all);
+	printf("\n");
+	bench_returns(root);
+
+	if(access(fox, X_OK)) {
+		log_warn("fox binary not found: %s", fox);
+		return 0;
+	}
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	bench_binary(fox, root, corpus, 1, all.bytes);
+	if(ncpu > 1) bench_binary(fox, root, corpus, (int)ncpu, all.bytes);
+
+	syntax_tree_trim();
+	source_trim();
+	return 0;
+}
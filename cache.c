@@ -0,0 +1,147 @@
+#include <unistd.h>
+
+#include "fox.h"
+#include "hmap.h"
+#include "symbol.h"
+#include "cache.h"
+
+#define CACHE_MAGIC "fox-cache"
+
+static struct cache_entry *cache_entry_create(const struct cache_entry *e) {
+	struct cache_entry *c = malloc(sizeof(struct cache_entry));
+	*c = *e;
+	c->src = fox_strdup(e->src);
+	return c;
+}
+
+static void cache_entry_release(struct cache_entry *e) {
+	free(e->src);
+	free(e);
+}
+
+static void cache_insert(struct fox_cache *c, const struct cache_entry *e) {
+	struct cache_entry *ce = cache_entry_create(e);
+	symbol_table_insert(c->entries, symbol_create(ce->src, ce));
+}
+
+/* read the manifest, a missing or outdated one gives an empty cache */
+static void cache_read(struct fox_cache *c) {
+	FILE *fp = fopen(c->path, "r");
+	if(!fp) return;
+
+	char line[2048];
+	if(!fgets(line, sizeof(line), fp)) {
+		fclose(fp);
+		return;
+	}
+	//outputs made with other options are stale too
+	char version[64], options[128], key[128];
+	fox_options_key(key, sizeof(key));
+	if(sscanf(line, CACHE_MAGIC " %63s %127s", version, options) != 2 ||
+	   strcmp(version, FOX_VERSION) || strcmp(options, key)) {
+		log_info("cache outdated, rebuild all: %s", c->path);
+		fclose(fp);
+		return;
+	}
+
+	while(fgets(line, sizeof(line), fp)) {
+		size_t l = strlen(line);
+		if(!l || line[l-1] != '\n') continue;
+		line[l-1] = '\0';
+
+		struct cache_entry e;
+		int off = 0;
+		if(sscanf(line, "%zx %zx %zu %lld %lld %n",
+				  &e.src_hash, &e.out_hash, &e.out_size,
+				  &e.mtime, &e.size, &off) != 5 || !line[off]) {
+			log_warn("bad cache entry: %s", line);
+			continue;
+		}
+		e.src = line + off;
+		if(!symbol_table_get(c->entries, e.src)) cache_insert(c, &e);
+	}
+	fclose(fp);
+}
+
+struct fox_cache *cache_load(const char *destdir) {
+	struct fox_cache *c = malloc(sizeof(struct fox_cache));
+	c->path = fox_strcat(destdir, "/" CACHE_FILENAME);
+	c->entries = symbol_table_create();
+	cache_read(c);
+	log_debug("cache loaded %s, entries:%zu", c->path, c->entries->count);
+	return c;
+}
+
+void cache_release(struct fox_cache *c) {
+	if(!c) return;
+	struct lnode *n = list_begin(&c->entries->order);
+	while(n != list_end(&c->entries->order)) {
+		cache_entry_release(((struct symbol *)n)->udata);
+		n = list_next(n);
+	}
+	symbol_table_release(c->entries);
+	free(c->path);
+	free(c);
+}
+
+struct cache_entry *cache_get(struct fox_cache *c, const char *src) {
+	struct symbol *s = symbol_table_get(c->entries, src);
+	return s ? s->udata : NULL;
+}
+
+void cache_set(struct fox_cache *c, const struct cache_entry *e) {
+	cache_remove(c, e->src);
+	//a newline would break the manifest, such a file is never cached
+	if(strchr(e->src, '\n')) return;
+	cache_insert(c, e);
+}
+
+void cache_remove(struct fox_cache *c, const char *src) {
+	struct symbol *s = symbol_table_get(c->entries, src);
+	if(!s) return;
+	symbol_table_remove(c->entries, s);
+	cache_entry_release(s->udata);
+	symbol_release(s);
+}
+
+/* forget sources which are gone */
+void cache_prune(struct fox_cache *c) {
+	struct lnode *n = list_begin(&c->entries->order);
+	while(n != list_end(&c->entries->order)) {
+		struct symbol *s = (struct symbol *)n;
+		n = list_next(n);
+		struct cache_entry *e = s->udata;
+		if(access(e->src, F_OK)) cache_remove(c, e->src);
+	}
+}
+
+/* write to a temp file first so a crash never leaves half a manifest */
+int cache_save(struct fox_cache *c) {
+	char *tmp = fox_strcat(c->path, ".tmp");
+	FILE *fp = fopen(tmp, "w");
+	if(!fp) {
+		log_error("open cache failed %s", tmp);
+		free(tmp);
+		return 0;
+	}
+
+	char key[128];
+	fox_options_key(key, sizeof(key));
+	fprintf(fp, CACHE_MAGIC " %s %s\n", FOX_VERSION, key);
+	for(struct lnode *n = list_begin(&c->entries->order); n != list_end(&c->entries->order); n = list_next(n)) {
+		struct cache_entry *e = ((struct symbol *)n)->udata;
+		fprintf(fp, "%016zx %016zx %zu %lld %lld %s\n",
+				e->src_hash, e->out_hash, e->out_size,
+				e->mtime, e->size, e->src);
+	}
+
+	int val = !ferror(fp);
+	if(fclose(fp)) val = 0;
+	if(val && rename(tmp, c->path)) val = 0;
+	if(!val) {
+		log_error("write cache failed %s", c->path);
+		unlink(tmp);
+	}
+	free(tmp);
+	return val;
+}
@@ -0,0 +1,32 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stddef.h>
+
+/* manifest kept in the dest folder, one entry per translated source */
+#define CACHE_FILENAME ".foxcache"
+
+struct cache_entry {
+	char *src;
+	size_t src_hash;		/* hash of the lua source */
+	size_t out_hash;		/* hash of the generated js */
+	size_t out_size;
+	long long mtime;		/* source mtime in ns, fast path */
+	long long size;			/* source size, fast path */
+};
+
+/* entries are dropped as a whole when FOX_VERSION changes */
+struct fox_cache {
+	char *path;
+	struct symbol_table *entries;	/* src path -> cache_entry */
+};
+
+struct fox_cache *cache_load(const char *destdir);
+void cache_release(struct fox_cache *c);
+struct cache_entry *cache_get(struct fox_cache *c, const char *src);
+void cache_set(struct fox_cache *c, const struct cache_entry *e);
+void cache_remove(struct fox_cache *c, const char *src);
+void cache_prune(struct fox_cache *c);
+int cache_save(struct fox_cache *c);
+
+#endif
@@ -0,0 +1,413 @@
+#include <limits.h>
+#include <math.h>
+
+#include "fox.h"
+#include "syntax.h"
+#include "output.h"
+#include "translator.h"
+
+/*
+ * constant folding after parsing. expressions are visited in post-order
+ * so operands are already folded, a node whose operands are literals is
+ * turned into a literal in place. results follow lua: integer arithmetic
+ * wraps, % and // floor, bitwise ops work on 64 bit integers. anything
+ * the emitted js would read differently is left alone, integers past
+ * 2^53, inf and nan, strings with escapes other than the common ones.
+ */
+
+#define FOLD_INT_MAX (1LL << 53)
+
+enum fold_kind {
+	FOLD_NONE,
+	FOLD_NIL,
+	FOLD_BOOL,
+	FOLD_INT,
+	FOLD_FLOAT,
+	FOLD_STRING,
+};
+
+struct fold_value {
+	enum fold_kind kind;
+	int boolean;
+	long long integer;
+	double number;
+	const char *s;		/* string contents, between the quotes */
+	size_t len;
+};
+
+static enum fold_kind fold_operand(struct syntax_node *n, struct fold_value *v) {
+	//parentheses only group
+	while(((struct syntax_expression *)n)->tag == EXP_PARENTHESIS) n = n->children;
+	struct syntax_expression *exp = (struct syntax_expression *)n;
+	v->kind = FOLD_NONE;
+	switch(exp->tag) {
+	case EXP_NIL:
+		v->kind = FOLD_NIL;
+		break;
+	case EXP_TRUE:
+	case EXP_FALSE:
+		v->kind = FOLD_BOOL;
+		v->boolean = exp->tag == EXP_TRUE;
+		break;
+	case EXP_NUMBER:
+		if(exp->isint) {
+			v->kind = FOLD_INT;
+			v->integer = exp->num.integer;
+		} else {
+			v->kind = FOLD_FLOAT;
+			v->number = exp->num.number;
+		}
+		break;
+	case EXP_STRING:
+	{
+		const char *s = exp->value.string;
+		size_t l = strpool_len(s);
+		if(l < 2 || (s[0] != '"' && s[0] != '\'')) break;
+		v->kind = FOLD_STRING;
+		v->s = s + 1;
+		v->len = l - 2;
+		break;
+	}
+	default:
+		break;
+	}
+	return v->kind;
+}
+
+static int fold_is_number(struct fold_value *v) {
+	return v->kind == FOLD_INT || v->kind == FOLD_FLOAT;
+}
+
+/* js && || ! only agree with lua on these, 0 and "" are true in lua */
+static int fold_is_logical(struct fold_value *v) {
+	return v->kind == FOLD_NIL || v->kind == FOLD_BOOL;
+}
+
+static double fold_float(struct fold_value *v) {
+	return v->kind == FOLD_INT ? (double)v->integer : v->number;
+}
+
+/* floats with an integral value convert, like lua does for bitwise ops */
+static int fold_to_int(struct fold_value *v, long long *i) {
+	if(v->kind == FOLD_INT) {
+		*i = v->integer;
+		return 1;
+	}
+	if(v->kind != FOLD_FLOAT || v->number != floor(v->number) ||
+	   v->number < -9223372036854775808.0 || v->number >= 9223372036854775808.0) return 0;
+	*i = (long long)v->number;
+	return 1;
+}
+
+/* byte length of the contents, -1 if an escape is not one js reads the same */
+static long fold_string_len(struct fold_value *v) {
+	long n = 0;
+	for(size_t i = 0; i < v->len; i++, n++) {
+		if(v->s[i] != '\\') continue;
+		if(++i == v->len || !strchr("ntr\\\"'", v->s[i])) return -1;
+	}
+	return n;
+}
+
+/* # of the unfolded string is its js length, which only bytes below 0x80 agree on */
+static int fold_string_ascii(struct fold_value *v) {
+	for(size_t i = 0; i < v->len; i++) {
+		if((unsigned char)v->s[i] >= 0x80) return 0;
+	}
+	return 1;
+}
+
+static void fold_replace(struct syntax_expression *exp, enum syntax_expression_tag tag) {
+	exp->tag = tag;
+	exp->n.children = NULL;
+	exp->n.count = 0;
+	exp->isint = 0;
+	exp->value.string = NULL;
+}
+
+static int fold_set_int(struct syntax_tree *t, struct syntax_expression *exp, long long i) {
+	if(i <= -FOLD_INT_MAX || i >= FOLD_INT_MAX) return 0;
+	char buf[32];
+	int l = snprintf(buf, sizeof(buf), "%lld", i);
+	fold_replace(exp, EXP_NUMBER);
+	exp->isint = 1;
+	exp->num.integer = i;
+	exp->value.string = syntax_tree_intern(t, buf, l);
+	return 1;
+}
+
+static int fold_set_float(struct syntax_tree *t, struct syntax_expression *exp, double d) {
+	if(!isfinite(d)) return 0;
+	char buf[40];
+	int l = output_format_double(buf, sizeof(buf), d);
+	fold_replace(exp, EXP_NUMBER);
+	exp->num.number = d;
+	exp->value.string = syntax_tree_intern(t, buf, l);
+	return 1;
+}
+
+static int fold_set_bool(struct syntax_expression *exp, int b) {
+	fold_replace(exp, b ? EXP_TRUE : EXP_FALSE);
+	return 1;
+}
+
+static int fold_set_value(struct syntax_expression *exp, struct syntax_node *from) {
+	while(((struct syntax_expression *)from)->tag == EXP_PARENTHESIS) from = from->children;
+	struct syntax_expression *src = (struct syntax_expression *)from;
+	enum syntax_expression_tag tag = src->tag;
+	char *s = src->value.string;
+	int isint = src->isint;
+	long long i = src->num.integer;
+	fold_replace(exp, tag);
+	exp->value.string = s;
+	exp->isint = isint;
+	exp->num.integer = i;
+	return 1;
+}
+
+static int fold_arith(struct syntax_tree *t, struct syntax_expression *exp, struct fold_value *a, struct fold_value *b) {
+	if(!fold_is_number(a) || !fold_is_number(b)) return 0;
+
+	if(a->kind == FOLD_INT && b->kind == FOLD_INT) {
+		unsigned long long x = a->integer, y = b->integer;
+		long long q, m;
+		switch(exp->tag) {
+		case EXP_ADD: return fold_set_int(t, exp, (long long)(x + y));
+		case EXP_SUB: return fold_set_int(t, exp, (long long)(x - y));
+		case EXP_MUL: return fold_set_int(t, exp, (long long)(x * y));
+		case EXP_MOD:
+			if(!b->integer || (b->integer == -1 && a->integer == LLONG_MIN)) return 0;
+			m = a->integer % b->integer;
+			if(m && (m ^ b->integer) < 0) m += b->integer;
+			return fold_set_int(t, exp, m);
+		case EXP_FDIV:
+			if(!b->integer || (b->integer == -1 && a->integer == LLONG_MIN)) return 0;
+			q = a->integer / b->integer;
+			if((a->integer % b->integer) && (a->integer ^ b->integer) < 0) q--;
+			return fold_set_int(t, exp, q);
+		default:
+			break;
+		}
+	}
+
+	double x = fold_float(a), y = fold_float(b), m;
+	switch(exp->tag) {
+	case EXP_ADD: return fold_set_float(t, exp, x + y);
+	case EXP_SUB: return fold_set_float(t, exp, x - y);
+	case EXP_MUL: return fold_set_float(t, exp, x * y);
+	case EXP_DIV: return fold_set_float(t, exp, x / y);
+	case EXP_EXP: return fold_set_float(t, exp, pow(x, y));
+	case EXP_FDIV: return fold_set_float(t, exp, floor(x / y));
+	case EXP_MOD:
+		m = fmod(x, y);
+		if(m != 0 && (m < 0) != (y < 0)) m += y;
+		return fold_set_float(t, exp, m);
+	default:
+		return 0;
+	}
+}
+
+static long long fold_shift(long long x, long long n) {
+	unsigned long long u = x;
+	if(n <= -64 || n >= 64) return 0;
+	return (long long)(n >= 0 ? u << n : u >> -n);
+}
+
+static int fold_bitwise(struct syntax_tree *t, struct syntax_expression *exp, struct fold_value *a, struct fold_value *b) {
+	long long x, y;
+	if(!fold_to_int(a, &x) || !fold_to_int(b, &y)) return 0;
+	switch(exp->tag) {
+	case EXP_BAND: return fold_set_int(t, exp, x & y);
+	case EXP_BOR: return fold_set_int(t, exp, x | y);
+	case EXP_XOR: return fold_set_int(t, exp, x ^ y);
+	case EXP_LSHIFT: return fold_set_int(t, exp, fold_shift(x, y));
+	case EXP_RSHIFT: return fold_set_int(t, exp, fold_shift(x, y == LLONG_MIN ? 64 : -y));
+	default: return 0;
+	}
+}
+
+static int fold_compare(struct syntax_expression *exp, struct fold_value *a, struct fold_value *b) {
+	if(exp->tag == EXP_EQ || exp->tag == EXP_NE) {
+		int eq;
+		if(fold_is_number(a) && fold_is_number(b)) {
+			eq = a->kind == FOLD_INT && b->kind == FOLD_INT ?
+				a->integer == b->integer : fold_float(a) == fold_float(b);
+		} else if(a->kind != b->kind) {
+			eq = 0;
+		} else if(a->kind == FOLD_NIL) {
+			eq = 1;
+		} else if(a->kind == FOLD_BOOL) {
+			eq = a->boolean == b->boolean;
+		} else {
+			//raw text compares only without escapes
+			if(memchr(a->s, '\\', a->len) || memchr(b->s, '\\', b->len)) return 0;
+			eq = a->len == b->len && !memcmp(a->s, b->s, a->len);
+		}
+		return fold_set_bool(exp, exp->tag == EXP_EQ ? eq : !eq);
+	}
+
+	if(!fold_is_number(a) || !fold_is_number(b)) return 0;
+	int lt, le;
+	if(a->kind == FOLD_INT && b->kind == FOLD_INT) {
+		lt = a->integer < b->integer;
+		le = a->integer <= b->integer;
+	} else {
+		double x = fold_float(a), y = fold_float(b);
+		lt = x < y;
+		le = x <= y;
+		if(isnan(x) || isnan(y)) return 0;
+	}
+	switch(exp->tag) {
+	case EXP_LESS: return fold_set_bool(exp, lt);
+	case EXP_LE: return fold_set_bool(exp, le);
+	case EXP_GREATER: return fold_set_bool(exp, !le);
+	case EXP_GE: return fold_set_bool(exp, !lt);
+	default: return 0;
+	}
+}
+
+/* append the contents of v to buf as the inside of a double quoted string */
+static int fold_concat_part(char *buf, size_t *len, struct fold_value *v) {
+	char num[32];
+	if(v->kind == FOLD_INT) {
+		int l = snprintf(num, sizeof(num), "%lld", v->integer);
+		memcpy(buf + *len, num, l);
+		*len += l;
+		return 1;
+	}
+	if(v->kind != FOLD_STRING || fold_string_len(v) < 0) return 0;
+	for(size_t i = 0; i < v->len; i++) {
+		char c = v->s[i];
+		if(c == '\\') {
+			buf[(*len)++] = c;
+			c = v->s[++i];
+		} else if(c == '"') {
+			buf[(*len)++] = '\\';
+		}
+		buf[(*len)++] = c;
+	}
+	return 1;
+}
+
+/* strings and integers, float to string conversion differs between lua and js */
+static int fold_concat(struct syntax_tree *t, struct syntax_expression *exp, struct fold_value *a, struct fold_value *b) {
+	if((a->kind != FOLD_STRING && a->kind != FOLD_INT) ||
+	   (b->kind != FOLD_STRING && b->kind != FOLD_INT)) return 0;
+	if(a->kind == FOLD_INT && b->kind == FOLD_INT) return 0;
+
+	size_t cap = 2 * (a->kind == FOLD_STRING ? a->len : 0) + 2 * (b->kind == FOLD_STRING ? b->len : 0) + 64;
+	char *buf = malloc(cap);
+	size_t len = 0;
+	buf[len++] = '"';
+	int ok = fold_concat_part(buf, &len, a) && fold_concat_part(buf, &len, b);
+	if(ok) {
+		buf[len++] = '"';
+		fold_replace(exp, EXP_STRING);
+		exp->value.string = syntax_tree_intern(t, buf, len);
+	}
+	free(buf);
+	return ok;
+}
+
+static int fold_unary(struct syntax_tree *t, struct syntax_expression *exp, struct fold_value *a) {
+	long long i;
+	switch(exp->tag) {
+	case EXP_NOT:
+		if(!fold_is_logical(a)) return 0;
+		return fold_set_bool(exp, a->kind == FOLD_NIL || (a->kind == FOLD_BOOL && !a->boolean));
+	case EXP_NEG:
+		if(a->kind == FOLD_INT) return fold_set_int(t, exp, (long long)(0ULL - (unsigned long long)a->integer));
+		if(a->kind == FOLD_FLOAT) return fold_set_float(t, exp, -a->number);
+		return 0;
+	case EXP_BNOT:
+		if(!fold_to_int(a, &i)) return 0;
+		return fold_set_int(t, exp, ~i);
+	case EXP_LEN:
+	{
+		if(a->kind != FOLD_STRING || !fold_string_ascii(a)) return 0;
+		long l = fold_string_len(a);
+		if(l < 0) return 0;
+		return fold_set_int(t, exp, l);
+	}
+	default:
+		return 0;
+	}
+}
+
+static void fold_expression(struct syntax_tree *t, struct syntax_expression *exp) {
+	struct syntax_node *c = exp->n.children;
+	struct fold_value a, b;
+	switch(exp->tag) {
+	case EXP_ADD:
+	case EXP_SUB:
+	case EXP_MUL:
+	case EXP_DIV:
+	case EXP_MOD:
+	case EXP_FDIV:
+	case EXP_EXP:
+		if(fold_operand(c, &a) && fold_operand(c->next, &b)) fold_arith(t, exp, &a, &b);
+		break;
+	case EXP_BAND:
+	case EXP_BOR:
+	case EXP_XOR:
+	case EXP_LSHIFT:
+	case EXP_RSHIFT:
+		if(fold_operand(c, &a) && fold_operand(c->next, &b)) fold_bitwise(t, exp, &a, &b);
+		break;
+	case EXP_LESS:
+	case EXP_GREATER:
+	case EXP_LE:
+	case EXP_GE:
+	case EXP_EQ:
+	case EXP_NE:
+		if(fold_operand(c, &a) && fold_operand(c->next, &b)) fold_compare(exp, &a, &b);
+		break;
+	case EXP_CONC:
+		if(fold_operand(c, &a) && fold_operand(c->next, &b)) fold_concat(t, exp, &a, &b);
+		break;
+	case EXP_AND:
+	case EXP_OR:
+	{
+		//both sides constant, the result is one of them
+		if(!fold_operand(c, &a) || !fold_operand(c->next, &b) || !fold_is_logical(&a)) break;
+		int truthy = !(a.kind == FOLD_NIL || (a.kind == FOLD_BOOL && !a.boolean));
+		fold_set_value(exp, (exp->tag == EXP_AND) == truthy ? c->next : c);
+		break;
+	}
+	case EXP_NOT:
+	case EXP_NEG:
+	case EXP_BNOT:
+	case EXP_LEN:
+		fold_operand(c, &a);
+		fold_unary(t, exp, &a);
+		break;
+	default:
+		break;
+	}
+}
+
+void fold_chunk_constants(struct syntax_tree *t, struct syntax_chunk *chunk) {
+	struct syntax_node *root = &chunk->n;
+	struct syntax_node *n = root;
+	while(n) {
+		if(n->children) {
+			n = n->children;
+			continue;
+		}
+		//leaf done, fold on the way up
+		while(1) {
+			struct syntax_node *next = n->next;
+			struct syntax_node *parent = n->parent;
+			if(n->type == STX_EXPRESSION) fold_expression(t, (struct syntax_expression *)n);
+			if(n == root) {
+				n = NULL;
+				break;
+			}
+			if(next) {
+				n = next;
+				break;
+			}
+			n = parent;
+		}
+	}
+}
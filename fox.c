@@ -3,17 +3,55 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
 
 #include "fox.h"
+#include "hmap.h"
 #include "symbol.h"
 #include "syntax.h"
+#include "output.h"
+#include "source.h"
 #include "translator.h"
+#include "cache.h"
+#include "stats.h"
 
-#ifdef DEBUG
-int log_level = LOG_DEBUG;
-#else
-int log_level = LOG_MSG;
-#endif
+/* one lua file to translate, collected before any work starts */
+struct job {
+	char *src;
+	char *dest;
+	int result;
+	bool finished;
+	char *log;		/* buffered log output of the job */
+	size_t loglen;
+	struct cache_entry *cached;	/* last build, read only while jobs run */
+	struct cache_entry entry;	/* this build */
+	bool skipped;
+	struct fox_stats *stats;	/* NULL unless --stats */
+	char *runtime;	/* the runtime as the dest requires it */
+};
+
+struct joblist {
+	struct job *jobs;
+	int count;
+	int cap;
+};
+
+struct worker_pool {
+	struct joblist *list;	/* jobs being run, NULL while idle */
+	int next;		/* next job to pick */
+	bool stop;
+	int njobs;		/* workers asked for */
+	pthread_t *threads;
+	int nthreads;	/* workers running, 0 runs jobs on the caller */
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+};
 
 int ensure_path(const char *srcpath, const char *destpath) {
 	int val = access(srcpath, R_OK);
@@ -54,7 +92,54 @@ int ensure_path(const char *srcpath, const char *destpath) {
 	return 0;
 }
 
-int process(const char *srcpath, const char *destpath) {
+static void joblist_push(struct joblist *l, const char *src, const char *dest) {
+	if(l->count == l->cap) {
+		l->cap = l->cap ? l->cap * 2 : 64;
+		l->jobs = realloc(l->jobs, sizeof(struct job) * l->cap);
+	}
+	struct job *j = &l->jobs[l->count++];
+	j->src = fox_strdup(src);
+	j->dest = fox_strdup(dest);
+	j->result = 0;
+	j->finished = FALSE;
+	j->log = NULL;
+	j->loglen = 0;
+	j->cached = NULL;
+	memset(&j->entry, 0, sizeof(struct cache_entry));
+	j->entry.src = j->src;
+	j->skipped = FALSE;
+	j->stats = NULL;
+	j->runtime = NULL;
+}
+
+static void joblist_clear(struct joblist *l) {
+	for(int i = 0; i < l->count; i++) {
+		free(l->jobs[i].src);
+		free(l->jobs[i].dest);
+		free(l->jobs[i].log);
+		free(l->jobs[i].stats);
+		free(l->jobs[i].runtime);
+	}
+	free(l->jobs);
+	l->jobs = NULL;
+	l->count = l->cap = 0;
+}
+
+/* a.lua -> a.js, other names are kept */
+static void lua_to_js(char *path) {
+	char *extname = strrchr(path, '.');
+	if(extname && !strcmp(extname, ".lua")) {
+		strcpy(extname, ".js");
+	}
+}
+
+static int compare_name(const void *a, const void *b) {
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* walk srcpath and collect every lua file, entries are sorted so the
+   job order (and the log output) does not depend on the filesystem */
+int collect(const char *srcpath, const char *destpath, struct joblist *l) {
 	int val = ensure_path(srcpath, destpath);
 	if(val) return val;
 
@@ -66,22 +151,7 @@ int process(const char *srcpath, const char *destpath) {
 			log_info("skip non-lua file: %s", srcpath);
 			return 0;
 		}
-
-		struct syntax_tree *tree = NULL;
-		struct symbol_table *table = NULL;
-		int val = parse(srcpath, &tree, &table);
-		if(!val) {
-			log_error("parse file failed:%s", srcpath);
-			return -1;
-		}
-
-		val = translate(destpath, tree, table);
-		syntax_tree_release(tree);
-		symbol_table_release(table);
-		if(!val) {
-			log_error("translate file failed:%s", destpath);
-			return -1;
-		}
+		joblist_push(l, srcpath, destpath);
 	} else if(S_ISDIR(st.st_mode)) {
 		DIR *dir = opendir(srcpath);
 		if(!dir) {
@@ -89,29 +159,42 @@ int process(const char *srcpath, const char *destpath) {
 			return -1;
 		}
 
+		int cnt = 0;
+		int cap = 0;
+		char **names = NULL;
 		struct dirent *ent;
 		while((ent = readdir(dir)) != NULL) {
 			if(!strcmp(ent->d_name, ".")) continue;
 			if(!strcmp(ent->d_name, "..")) continue;
-
-			char cursrc[1024];
-			strcpy(cursrc, srcpath);
-			strcat(cursrc, "/");
-			strcat(cursrc, ent->d_name);
-
-			char curdest[1024];
-			strcpy(curdest, destpath);
-			strcat(curdest, "/");
-			strcat(curdest, ent->d_name);
-			char * extname = strrchr(curdest, '.');
-			if(extname && !strcmp(extname, ".lua")) {
-				strcpy(extname, ".js");
+			if(cnt == cap) {
+				cap = cap ? cap * 2 : 16;
+				names = realloc(names, sizeof(char *) * cap);
 			}
-
-			int val = process(cursrc, curdest);
-			if(val) return val;
+			names[cnt++] = fox_strdup(ent->d_name);
 		}
 		closedir(dir);
+		qsort(names, cnt, sizeof(char *), compare_name);
+
+		val = 0;
+		for(int i = 0; i < cnt; i++) {
+			if(!val) {
+				char cursrc[1024];
+				strcpy(cursrc, srcpath);
+				strcat(cursrc, "/");
+				strcat(cursrc, names[i]);
+
+				char curdest[1024];
+				strcpy(curdest, destpath);
+				strcat(curdest, "/");
+				strcat(curdest, names[i]);
+				lua_to_js(curdest);
+
+				val = collect(cursrc, curdest, l);
+			}
+			free(names[i]);
+		}
+		free(names);
+		if(val) return val;
 	} else {
 		log_warn("illeagal file: %s", srcpath);
 		return 0;
@@ -120,41 +203,634 @@ int process(const char *srcpath, const char *destpath) {
 	return 0;
 }
 
-const char *usage = "usage: fox src dest (support file or folder)\n";
+/* the last output is still in place and untouched in size */
+static int job_output_intact(struct job *j) {
+	struct stat st;
+	return !stat(j->dest, &st) && (size_t)st.st_size == j->cached->out_size;
+}
+
+static void job_skip(struct job *j) {
+	j->entry.src_hash = j->cached->src_hash;
+	j->entry.out_hash = j->cached->out_hash;
+	j->entry.out_size = j->cached->out_size;
+	j->skipped = TRUE;
+	if(j->stats) j->stats->skipped = 1;
+	log_info("up to date: %s", j->src);
+}
+
+int process(struct job *j) {
+	struct fox_stats *stats = j->stats;
+	if(stats) stats->files = 1;
+	struct stat st;
+	if(stat(j->src, &st)) {
+		log_error("can not stat file:%s", j->src);
+		return -1;
+	}
+	j->entry.mtime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+	j->entry.size = st.st_size;
+
+	//fast path, same mtime and size as the last build
+	if(j->cached && j->cached->mtime == j->entry.mtime &&
+	   j->cached->size == j->entry.size && job_output_intact(j)) {
+		job_skip(j);
+		return 0;
+	}
+
+	struct fox_source src;
+	if(!source_open(&src, j->src)) {
+		log_error("parse file failed:%s", j->src);
+		return -1;
+	}
+	if(stats) stats->bytes_in = src.len;
+	j->entry.src_hash = hash_bytes(src.data, src.len, 0);
+	if(j->cached && j->cached->src_hash == j->entry.src_hash && job_output_intact(j)) {
+		source_close(&src);
+		job_skip(j);
+		return 0;
+	}
+
+	struct syntax_tree *tree = NULL;
+	struct symbol_table *table = NULL;
+	int val = parse_source_stats(j->src, &src, &tree, &table, stats);
+	source_close(&src);
+	if(!val) {
+		log_error("parse file failed:%s", j->src);
+		return -1;
+	}
+	if(stats) stats_tree(stats, tree);
+
+	log_info("translate lua program start: %s", j->dest);
+	struct fox_output out;
+	output_init(&out);
+	output_reserve(&out, OUTPUT_INIT_CAP);
+	double t = stats ? stats_now() : 0;
+	val = translate_output_runtime(&out, tree, table, j->runtime);
+	syntax_tree_release(tree);
+	symbol_table_release(table);
+	if(stats) {
+		stats->translate = stats_now() - t;
+		stats->bytes_out = out.len;
+		stats->memory += out.cap;
+	}
+	if(val) {
+		j->entry.out_hash = hash_bytes(out.data, out.len, 0);
+		j->entry.out_size = out.len;
+		t = stats ? stats_now() : 0;
+		val = output_write_file(&out, j->dest);
+		if(stats) stats->write = stats_now() - t;
+	}
+	output_release(&out);
+	if(!val) {
+		log_error("translate file failed:%s", j->dest);
+		return -1;
+	}
+	log_info("translate lua program succeed:%s", j->dest);
+	return 0;
+}
+
+static void *worker_main(void *arg) {
+	struct worker_pool *pool = arg;
+	pthread_mutex_lock(&pool->lock);
+	while(1) {
+		if(pool->stop) break;
+		if(!pool->list || pool->next >= pool->list->count) {
+			pthread_cond_wait(&pool->work, &pool->lock);
+			continue;
+		}
+		struct job *j = &pool->list->jobs[pool->next++];
+		pthread_mutex_unlock(&pool->lock);
+
+		char *log = NULL;
+		size_t loglen = 0;
+		log_fp = open_memstream(&log, &loglen);
+		int val = process(j);
+		if(log_fp) fclose(log_fp);
+		log_fp = NULL;
+
+		pthread_mutex_lock(&pool->lock);
+		j->result = val;
+		j->log = log;
+		j->loglen = loglen;
+		j->finished = TRUE;
+		pthread_cond_broadcast(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	syntax_tree_trim();
+	source_trim();
+	return NULL;
+}
+
+/* start nthreads workers, they wait for job lists until the pool is
+   released and keep their spare tree and source buffer in between.
+   fewer than two runs jobs on the calling thread */
+static void pool_init(struct worker_pool *pool, int njobs, int nthreads) {
+	pool->list = NULL;
+	pool->next = 0;
+	pool->stop = FALSE;
+	pool->njobs = njobs;
+	pool->threads = NULL;
+	pool->nthreads = 0;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	if(nthreads <= 1) return;
+
+	pool->threads = malloc(sizeof(pthread_t) * nthreads);
+	for(int i = 0; i < nthreads; i++) {
+		if(pthread_create(&pool->threads[pool->nthreads], NULL, worker_main, pool)) {
+			log_warn("create worker thread failed, %d workers running", pool->nthreads);
+			break;
+		}
+		pool->nthreads++;
+	}
+}
+
+static void pool_release(struct worker_pool *pool) {
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = TRUE;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	for(int i = 0; i < pool->nthreads; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	free(pool->threads);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/* run all jobs on the pool workers, logs are flushed in job order */
+int process_jobs(struct worker_pool *pool, struct joblist *l) {
+	int failed = 0;
+	if(!pool->nthreads) {
+		for(int i = 0; i < l->count; i++) {
+			int val = process(&l->jobs[i]);
+			l->jobs[i].result = val;
+			l->jobs[i].finished = TRUE;
+			if(val) return val;
+		}
+		return 0;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->list = l;
+	pool->next = 0;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(int i = 0; i < l->count; i++) {
+		struct job *j = &l->jobs[i];
+		pthread_mutex_lock(&pool->lock);
+		while(!j->finished) pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+
+		if(j->log) fwrite(j->log, 1, j->loglen, stdout);
+		if(j->result) failed++;
+	}
+
+	//every job finished, no worker holds on to the list
+	pthread_mutex_lock(&pool->lock);
+	pool->list = NULL;
+	pthread_mutex_unlock(&pool->lock);
+
+	if(failed) {
+		log_error("%d of %d files failed", failed, l->count);
+		return -1;
+	}
+	return 0;
+}
+
+/* the manifest lives in the dest folder, or next to the dest file */
+static char *cache_dir(const char *srcpath, const char *destpath) {
+	struct stat st;
+	if(!stat(srcpath, &st) && S_ISDIR(st.st_mode)) {
+		return fox_strdup(destpath);
+	}
+	char *dest = fox_strdup(destpath);
+	char *dir = fox_strdup(dirname(dest));
+	free(dest);
+	return dir;
+}
+
+/* the path a module at dest requires the runtime in root by */
+static char *runtime_path(const char *root, const char *dest) {
+	size_t l = strlen(root);
+	int depth = 0;
+	if(!strncmp(dest, root, l) && dest[l] == '/') {
+		for(const char *p = dest + l + 1; *p; p++) {
+			if(*p == '/') depth++;
+		}
+	}
+	char *path = malloc(3 * depth + sizeof("./" FOX_RUNTIME));
+	char *p = path;
+	if(!depth) {
+		strcpy(p, "./");
+		p += 2;
+	}
+	while(depth--) {
+		strcpy(p, "../");
+		p += 3;
+	}
+	strcpy(p, FOX_RUNTIME);
+	return path;
+}
+
+/* the runtime goes beside the manifest, written again when it differs */
+static int runtime_write(const char *root) {
+	char *path = fox_strcat(root, "/" FOX_RUNTIME);
+	size_t len = strlen(fox_runtime_js);
+	bool same = FALSE;
+	FILE *fp = fopen(path, "rb");
+	if(fp) {
+		char *buf = malloc(len + 1);
+		same = fread(buf, 1, len + 1, fp) == len && !memcmp(buf, fox_runtime_js, len);
+		free(buf);
+		fclose(fp);
+	}
+	int val = 0;
+	if(!same) {
+		fp = fopen(path, "wb");
+		if(!fp || fwrite(fox_runtime_js, 1, len, fp) != len) {
+			log_error("write runtime failed %s", path);
+			val = -1;
+		}
+		if(fp && fclose(fp)) val = -1;
+	}
+	free(path);
+	return val;
+}
+
+/* record the jobs which ran, failed ones are rebuilt next time */
+static void cache_update(struct fox_cache *c, struct joblist *l) {
+	int skipped = 0;
+	for(int i = 0; i < l->count; i++) {
+		struct job *j = &l->jobs[i];
+		if(!j->finished) continue;
+		if(j->result) {
+			cache_remove(c, j->src);
+			continue;
+		}
+		if(j->skipped) skipped++;
+		cache_set(c, &j->entry);
+	}
+	if(skipped) log_info("%d of %d files up to date", skipped, l->count);
+}
+
+/* the run as json, per file and in total */
+static void write_stats(const char *path, struct joblist *l, int njobs, double wall) {
+	FILE *fp = strcmp(path, "-") ? fopen(path, "w") : stdout;
+	if(!fp) {
+		log_error("open stats file failed %s", path);
+		return;
+	}
+
+	struct fox_stats total;
+	stats_init(&total);
+	for(int i = 0; i < l->count; i++) {
+		if(l->jobs[i].stats) stats_add(&total, l->jobs[i].stats);
+	}
+	struct rusage ru;
+	long peak = getrusage(RUSAGE_SELF, &ru) ? 0 : ru.ru_maxrss;
+
+	fprintf(fp, "{\n  \"version\": \"%s\",\n  \"jobs\": %d,\n", FOX_VERSION, njobs);
+	fprintf(fp, "  \"wall_ms\": %.3f,\n  \"peak_rss_kb\": %ld,\n", wall * 1e3, peak);
+	fprintf(fp, "  \"total\": {\n");
+	stats_write_json(fp, &total, 4);
+	fprintf(fp, "\n  },\n  \"files\": [");
+	for(int i = 0; i < l->count; i++) {
+		struct job *j = &l->jobs[i];
+		if(!j->stats) continue;
+		fprintf(fp, "%s\n    {\n      \"src\": ", i ? "," : "");
+		stats_write_string(fp, j->src);
+		fprintf(fp, ",\n      \"dest\": ");
+		stats_write_string(fp, j->dest);
+		fprintf(fp, ",\n      \"result\": %d,\n", j->finished ? j->result : -1);
+		stats_write_json(fp, j->stats, 6);
+		fprintf(fp, "\n    }");
+	}
+	fprintf(fp, "\n  ]\n}\n");
+	if(fp != stdout) fclose(fp);
+}
+
+/* translate the jobs, the cache is updated and saved afterwards. root is
+   the dest folder the runtime lives in */
+static int build(struct joblist *l, struct fox_cache *cache, const char *root,
+				 struct worker_pool *pool, bool force, const char *stats) {
+	if(runtime_write(root)) return -1;
+	for(int i = 0; i < l->count; i++) {
+		struct job *j = &l->jobs[i];
+		j->runtime = runtime_path(root, j->dest);
+		if(!force) j->cached = cache_get(cache, j->src);
+		if(stats) {
+			j->stats = malloc(sizeof(struct fox_stats));
+			stats_init(j->stats);
+		}
+	}
+	double t = stats_now();
+	int val = process_jobs(pool, l);
+	t = stats_now() - t;
+	cache_update(cache, l);
+	cache_save(cache);
+	if(stats) write_stats(stats, l, pool->njobs, t);
+	return val;
+}
+
+#define WATCH_DEBOUNCE_MS 100
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+struct watch_dir {
+	char *src;
+	char *dest;
+};
+
+struct watcher {
+	int fd;
+	const char *srcpath;
+	const char *destpath;
+	const char *root;			/* dest folder of the runtime */
+	char *file;					/* watched name when srcpath is a file */
+	struct hmap dirs;			/* watch descriptor -> watch_dir */
+	struct joblist pending;		/* changed files waiting for the debounce */
+	struct symbol_table *queued;	/* src paths in pending */
+};
+
+static void watch_add(struct watcher *w, const char *src, const char *dest) {
+	int wd = inotify_add_watch(w->fd, src, WATCH_EVENTS | IN_ONLYDIR);
+	if(wd < 0) {
+		log_warn("watch folder failed %s: %s", src, strerror(errno));
+		return;
+	}
+	struct watch_dir *d = NULL;
+	if(hmap_get(&w->dirs, HKEY_INT(wd), (void **)&d)) return;
+	d = malloc(sizeof(struct watch_dir));
+	d->src = fox_strdup(src);
+	d->dest = fox_strdup(dest);
+	hmap_insert(&w->dirs, HKEY_INT(wd), d);
+
+	//a file has its folder watched, which is not walked
+	if(w->file) return;
+	DIR *dir = opendir(src);
+	if(!dir) return;
+	struct dirent *ent;
+	while((ent = readdir(dir)) != NULL) {
+		if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) continue;
+		char cursrc[1024];
+		snprintf(cursrc, sizeof(cursrc), "%s/%s", src, ent->d_name);
+		struct stat st;
+		if(stat(cursrc, &st) || !S_ISDIR(st.st_mode)) continue;
+		char curdest[1024];
+		snprintf(curdest, sizeof(curdest), "%s/%s", dest, ent->d_name);
+		watch_add(w, cursrc, curdest);
+	}
+	closedir(dir);
+}
+
+static void watch_dir_release(size_t key, void *value) {
+	struct watch_dir *d = value;
+	free(d->src);
+	free(d->dest);
+	free(d);
+}
+
+static void watch_queue(struct watcher *w, const char *src, const char *dest) {
+	if(symbol_table_get(w->queued, src)) return;
+	int count = w->pending.count;
+	collect(src, dest, &w->pending);
+	for(int i = count; i < w->pending.count; i++) {
+		struct symbol *s = symbol_create(w->pending.jobs[i].src, NULL);
+		if(!symbol_table_insert(w->queued, s)) symbol_release(s);
+	}
+}
+
+static void watch_event(struct watcher *w, struct inotify_event *ev) {
+	if(ev->mask & IN_Q_OVERFLOW) {
+		log_warn("watch events lost, rescan %s", w->srcpath);
+		watch_queue(w, w->srcpath, w->destpath);
+		return;
+	}
+
+	struct watch_dir *d = NULL;
+	if(ev->mask & IN_IGNORED) {
+		if(hmap_remove(&w->dirs, HKEY_INT(ev->wd), (void **)&d)) watch_dir_release(0, d);
+		return;
+	}
+	if(!ev->len || !hmap_get(&w->dirs, HKEY_INT(ev->wd), (void **)&d)) return;
+
+	if(w->file) {
+		if(!strcmp(ev->name, w->file) && (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+			watch_queue(w, w->srcpath, w->destpath);
+		}
+		return;
+	}
+
+	char src[1024];
+	snprintf(src, sizeof(src), "%s/%s", d->src, ev->name);
+	char dest[1024];
+	snprintf(dest, sizeof(dest), "%s/%s", d->dest, ev->name);
+	if(ev->mask & IN_ISDIR) {
+		if(ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+			watch_add(w, src, dest);
+			watch_queue(w, src, dest);
+		}
+	} else if(ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+		char *extname = strrchr(ev->name, '.');
+		if(!extname || strcmp(extname, ".lua")) return;
+		lua_to_js(dest);
+		watch_queue(w, src, dest);
+	}
+}
+
+static void watch_flush(struct watcher *w, struct fox_cache *cache, struct worker_pool *pool,
+						bool force, const char *stats) {
+	log_info("changes detected, %d files", w->pending.count);
+	int val = build(&w->pending, cache, w->root, pool, force, stats);
+	if(val) {
+		log_error("processing error! error code:%d\n", val);
+	} else {
+		log_info("processing succeed!\n");
+	}
+	joblist_clear(&w->pending);
+	symbol_table_release(w->queued);
+	w->queued = symbol_table_create();
+}
+
+/* translate changed files until killed, after the first full pass. the
+   pool outlives every batch, so workers and a serial main thread keep
+   their spare syntax tree and source buffer warm between events */
+static int watch(const char *srcpath, const char *destpath, const char *root,
+				 struct fox_cache *cache, struct worker_pool *pool, bool force, const char *stats) {
+	struct watcher w;
+	w.fd = inotify_init1(IN_CLOEXEC);
+	if(w.fd < 0) {
+		log_error("inotify init failed: %s", strerror(errno));
+		return -1;
+	}
+	w.srcpath = srcpath;
+	w.destpath = destpath;
+	w.root = root;
+	w.file = NULL;
+	hmap_init(&w.dirs, HMAP_MIN_CAP);
+	w.pending.jobs = NULL;
+	w.pending.count = w.pending.cap = 0;
+	w.queued = symbol_table_create();
+
+	struct stat st;
+	if(!stat(srcpath, &st) && S_ISDIR(st.st_mode)) {
+		watch_add(&w, srcpath, destpath);
+	} else {
+		char *src = fox_strdup(srcpath);
+		char *dest = fox_strdup(destpath);
+		w.file = fox_strdup(basename(src));
+		watch_add(&w, dirname(src), dirname(dest));
+		free(src);
+		free(dest);
+	}
+	log_info("watching %s for changes", srcpath);
+
+	int val = 0;
+	char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while(!val) {
+		struct pollfd p = { w.fd, POLLIN, 0 };
+		int n = poll(&p, 1, w.pending.count ? WATCH_DEBOUNCE_MS : -1);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			log_error("watch poll failed: %s", strerror(errno));
+			val = -1;
+		} else if(n == 0) {
+			watch_flush(&w, cache, pool, force, stats);
+		} else {
+			ssize_t len = read(w.fd, buf, sizeof(buf));
+			if(len < 0) {
+				if(errno == EINTR || errno == EAGAIN) continue;
+				log_error("watch read failed: %s", strerror(errno));
+				val = -1;
+			}
+			for(char *c = buf; c < buf + len; ) {
+				struct inotify_event *ev = (struct inotify_event *)c;
+				watch_event(&w, ev);
+				c += sizeof(struct inotify_event) + ev->len;
+			}
+		}
+	}
+
+	close(w.fd);
+	hmap_clear(&w.dirs, watch_dir_release);
+	joblist_clear(&w.pending);
+	symbol_table_release(w.queued);
+	free(w.file);
+	return val;
+}
+
+const char *usage = "usage: fox [-f] [-j jobs] [--watch] [--stats file] [--no-fold] [--json-min bytes] [--minify] src dest (support file or folder, -f ignores the build cache)\n";
+
+static struct option long_options[] = {
+	{ "watch", no_argument, NULL, 'w' },
+	{ "stats", required_argument, NULL, 's' },
+	{ "no-fold", no_argument, NULL, 'F' },
+	{ "json-min", required_argument, NULL, 'J' },
+	{ "minify", no_argument, NULL, 'M' },
+	{ NULL, 0, NULL, 0 }
+};
 
 int main(int argc, char **argv) {
-	if(argc < 3) {
+	int njobs = 1;
+	bool force = FALSE;
+	bool watching = FALSE;
+	const char *stats = NULL;
+	int opt;
+	while((opt = getopt_long(argc, argv, "fj:w", long_options, NULL)) != -1) {
+		switch(opt) {
+		case 'f':
+			force = TRUE;
+			break;
+		case 'w':
+			watching = TRUE;
+			break;
+		case 's':
+			stats = optarg;
+			break;
+		case 'F':
+			fox_options.fold = 0;
+			break;
+		case 'J':
+			fox_options.json_min = atoi(optarg);
+			if(fox_options.json_min < 0) {
+				log_error("illeagal json size: %s\n%s", optarg, usage);
+				return 1;
+			}
+			break;
+		case 'M':
+			fox_options.minify = 1;
+			break;
+		case 'j':
+			njobs = atoi(optarg);
+			if(njobs <= 0) {
+				log_error("illeagal jobs count: %s\n%s", optarg, usage);
+				return 1;
+			}
+			break;
+		default:
+			log_error("unknown option!\n%s", usage);
+			return 1;
+		}
+	}
+
+	if(argc - optind < 2) {
 		log_error("too few params!\n%s", usage);
 		return 1;
 	}
-	if(argc > 3) {
+	if(argc - optind > 2) {
 		log_error("too many params!\n%s", usage);
 		return 1;
 	}
 
-	log_info("processing start... src: %s, dest: %s", argv[1], argv[2]);
+	const char *src = argv[optind];
+	const char *dest = argv[optind+1];
+	log_info("processing start... src: %s, dest: %s, jobs: %d", src, dest, njobs);
 
-	int srclen = strlen(argv[1]);
+	int srclen = strlen(src);
 	char *srcpath = malloc(srclen+1);
-	strcpy(srcpath, argv[1]);
+	strcpy(srcpath, src);
 	if(srcpath[srclen-1] == '/') {
 		srcpath[srclen-1] = '\0';
 	}
 
-	int destlen = strlen(argv[2]);
-	char *destpath = malloc(srclen+1);
-	strcpy(destpath, argv[2]);
+	int destlen = strlen(dest);
+	char *destpath = malloc(destlen+1);
+	strcpy(destpath, dest);
 	if(destpath[destlen-1] == '/') {
 		destpath[destlen-1] = '\0';
 	}
 
-	int val = process(srcpath, destpath);
+	struct fox_cache *cache = NULL;
+	struct joblist list = { NULL, 0, 0 };
+	char *dir = cache_dir(srcpath, destpath);
+	int val = collect(srcpath, destpath, &list);
+	//the watch batches reuse the workers, a single build needs no more than its files
+	struct worker_pool pool;
+	pool_init(&pool, njobs, watching || njobs < list.count ? njobs : list.count);
+	if(!val) {
+		cache = cache_load(dir);
+		cache_prune(cache);
+		val = build(&list, cache, dir, &pool, force, stats);
+	}
+	joblist_clear(&list);
+
 	if(val) {
 		log_error("processing error! error code:%d\n", val);
 	} else {
 		log_info("processing succeed!\n");
 	}
 
+	if(cache && watching) {
+		val = watch(srcpath, destpath, dir, cache, &pool, force, stats);
+	}
+	pool_release(&pool);
+	free(dir);
+	cache_release(cache);
+	syntax_tree_trim();
+	source_trim();
+
 	free(srcpath);
 	free(destpath);
 	return val;
@@ -8,9 +8,37 @@
 #include <string.h>
 #include <assert.h>
 
-#define FOX_VERSION "0.0.1"
+#define FOX_VERSION "0.0.2"
+
+/* the js runtime every translated module requires, one per dest folder */
+#define FOX_RUNTIME "fox_runtime.js"
+extern const char fox_runtime_js[];
+
+struct fox_output;
+
+/* translation switches, set before any work starts */
+struct fox_options {
+	int fold;			/* fold constant expressions */
+	int minify;			/* squeeze the js and rename locals */
+	int json_min;		/* literal tables this many bytes or larger go through JSON.parse, 0 never */
+};
+
+extern struct fox_options fox_options;
+
+/* the options that change the generated js, as one word */
+int fox_options_key(char *buf, size_t len);
+
+/* translate lua source in memory, the js is appended to out (see output.h),
+   which stays owned by the caller. the js requires fox_runtime_js saved as
+   FOX_RUNTIME beside it. nothing is cached for the next call, the
+   calling thread keeps no tree. returns 1 on success, 0 on failure */
+int fox_translate_buffer(const char *src, size_t len, struct fox_output *out);
 
 extern int log_level;
+/* per-thread log stream, NULL means stdout */
+extern __thread FILE *log_fp;
+#define log_stream() (log_fp ? log_fp : stdout)
+
 #define LOG_NO    0
 #define LOG_ERR   1
 #define LOG_WARN  2
@@ -21,28 +49,28 @@ extern int log_level;
 	if(log_level >= LOG_ERR) {					\
 		char errmsg[1024];						\
 		sprintf(errmsg, fmt, ##__VA_ARGS__);	\
-		fprintf(stdout, "[ERROR]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg);	\
+		fprintf(log_stream(), "[ERROR]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg);	\
 	}
 
 #define log_warn(fmt, ...)             			\
 	if(log_level >= LOG_WARN) {					\
 		char errmsg[1024];						\
 		sprintf(errmsg, fmt, ##__VA_ARGS__);	\
-		fprintf(stdout, "[WARN]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg); \
+		fprintf(log_stream(), "[WARN]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg); \
 	}
 
 #define log_info(fmt, ...)                      \
 	if(log_level >= LOG_MSG) {					\
 		char errmsg[1024];						\
 		sprintf(errmsg, fmt, ##__VA_ARGS__);	\
-		fprintf(stdout, "[INFO]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg); \
+		fprintf(log_stream(), "[INFO]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg); \
 	}
 
 #define log_debug(fmt, ...)                     \
 	if(log_level >= LOG_DEBUG) {				\
 		char errmsg[1024];						\
 		sprintf(errmsg, fmt, ##__VA_ARGS__);	\
-		fprintf(stdout, "[DEBUG]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg); \
+		fprintf(log_stream(), "[DEBUG]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg); \
 	}
 
 #define log_assert(condition, fmt, ...)			\
@@ -50,7 +78,7 @@ extern int log_level;
 		if(log_level >= LOG_ERR) {				\
 			char errmsg[1024];					\
 			sprintf(errmsg, fmt, ##__VA_ARGS__);\
-			fprintf(stdout, "[ERROR]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg);	\
+			fprintf(log_stream(), "[ERROR]FILE:%s LINE:%d %s\n", __FILE__, __LINE__, errmsg);	\
 		}										\
 	}											\
 	assert(condition)
@@ -92,8 +120,8 @@ static inline char *fox_strdup(const char *s) {
 	if(s == NULL) return NULL;
 	size_t l = strlen(s);
 	char *d = malloc(l+1);
-	memset(d, 0, l+1);
-	if(l > 0) strncpy(d, s, l);
+	memcpy(d, s, l);
+	d[l] = '\0';
 	return d;
 }
 
@@ -109,16 +137,12 @@ static inline char *fox_strcat(const char *s0, const char * s1) {
 		return fox_strdup(s0);
 	}
 
-	int l0 = strlen(s0);
-	int l1 = strlen(s1);
+	size_t l0 = strlen(s0);
+	size_t l1 = strlen(s1);
 	char *d = malloc(l0 + l1 + 1);
-	memset(d, 0, l0+l1+1);
-	if(l0 > 0) {
-		strncpy(d, s0, l0);			
-	}
-	if(l1 > 0) {
-		strncpy(d + l0, s1, l1);
-	}
+	memcpy(d, s0, l0);
+	memcpy(d + l0, s1, l1);
+	d[l0 + l1] = '\0';
 	return d;
 }
 
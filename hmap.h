@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #define HKEY_INT(i) ((size_t)(i))
 #define HKEY_STR(s) (hash_string(s))
@@ -13,7 +14,7 @@
 
 static inline size_t hash_string(const char *s) {
 	if(!s) return 0;
-	
+
 	size_t hash = 5381;
     int c = 0;
     while ((c = *s++)) {
@@ -22,108 +23,253 @@ static inline size_t hash_string(const char *s) {
     return hash;
 }
 
-struct hnode {
-	struct hnode *next;
+/* wyhash style hash over bytes, seed makes tables keyed differently */
+static const uint64_t hash_wyp[4] = {
+	0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+	0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL
+};
+
+static inline void hash_wymum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hash_wymix(uint64_t a, uint64_t b) {
+	hash_wymum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t hash_wyr8(const unsigned char *p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline uint64_t hash_wyr4(const unsigned char *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint64_t hash_wyr3(const unsigned char *p, size_t k) {
+	return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static inline size_t hash_bytes(const char *s, size_t l, uint64_t seed) {
+	const unsigned char *p = (const unsigned char *)s;
+	uint64_t a, b;
+	seed ^= hash_wymix(seed ^ hash_wyp[0], hash_wyp[1]);
+	if(l <= 16) {
+		if(l >= 4) {
+			a = (hash_wyr4(p) << 32) | hash_wyr4(p + ((l >> 3) << 2));
+			b = (hash_wyr4(p + l - 4) << 32) | hash_wyr4(p + l - 4 - ((l >> 3) << 2));
+		} else if(l > 0) {
+			a = hash_wyr3(p, l);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = l;
+		if(i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = hash_wymix(hash_wyr8(p) ^ hash_wyp[1], hash_wyr8(p + 8) ^ seed);
+				see1 = hash_wymix(hash_wyr8(p + 16) ^ hash_wyp[2], hash_wyr8(p + 24) ^ see1);
+				see2 = hash_wymix(hash_wyr8(p + 32) ^ hash_wyp[3], hash_wyr8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while(i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while(i > 16) {
+			seed = hash_wymix(hash_wyr8(p) ^ hash_wyp[1], hash_wyr8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = hash_wyr8(p + i - 16);
+		b = hash_wyr8(p + i - 8);
+	}
+	a ^= hash_wyp[1];
+	b ^= seed;
+	hash_wymum(&a, &b);
+	return (size_t)hash_wymix(a ^ hash_wyp[0] ^ l, b ^ hash_wyp[1]);
+}
+
+/*
+ * open addressing map with robin hood probing, slots hold the key, its
+ * mixed hash and the value inline. hash 0 marks an empty slot.
+ */
+struct hslot {
+	size_t hash;
 	size_t key;
 	void* value;
 };
-	
+
 struct hmap {
-	size_t bsize;
-	struct hnode *bucket;
+	size_t cap;		/* power of 2 */
+	struct hslot *slots;
 	size_t count;
 };
 
+#define HMAP_MIN_CAP 8
+/* grow when count exceeds cap * HMAP_LOAD_NUM / HMAP_LOAD_DEN */
+#define HMAP_LOAD_NUM 4
+#define HMAP_LOAD_DEN 5
+
 typedef void (*hmap_handler)(size_t key, void *value);
 
+/* keys are often hashes or aligned pointers, spread them over all bits */
+static inline size_t hmap_hash(size_t key) {
+	uint64_t h = key;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h ? (size_t)h : 1;
+}
+
+static inline size_t hmap_dist(struct hmap *m, size_t hash, size_t idx) {
+	return (idx - (hash & (m->cap - 1))) & (m->cap - 1);
+}
+
 static inline void hmap_init(struct hmap *m, size_t bsize) {
-	m->bsize = bsize;
-	m->bucket = malloc(sizeof(struct hnode) * bsize);
-	memset(m->bucket, 0, sizeof(struct hnode) * bsize);
-	m->count = 0;	
+	size_t cap = HMAP_MIN_CAP;
+	while(cap < bsize) cap <<= 1;
+	m->cap = cap;
+	m->slots = malloc(sizeof(struct hslot) * cap);
+	memset(m->slots, 0, sizeof(struct hslot) * cap);
+	m->count = 0;
 }
 
 static inline int hmap_empty(struct hmap *m) {
 	return m->count == 0;
 }
 
+static inline struct hslot *hmap_find(struct hmap *m, size_t key) {
+	size_t hash = hmap_hash(key);
+	size_t mask = m->cap - 1;
+	size_t idx = hash & mask;
+	for(size_t d = 0; ; d++) {
+		struct hslot *s = &m->slots[idx];
+		if(!s->hash || hmap_dist(m, s->hash, idx) < d) return NULL;
+		if(s->hash == hash && s->key == key) return s;
+		idx = (idx + 1) & mask;
+	}
+}
+
 static inline int hmap_get(struct hmap *m, size_t key, void **value) {
-	struct hnode *n = m->bucket[key % m->bsize].next;
-	while(n) {
-		if(n->key == key) {
-			if(value) {
-				*value = n->value;
-			}
-			return 1;
+	struct hslot *s = hmap_find(m, key);
+	if(!s) return 0;
+	if(value) {
+		*value = s->value;
+	}
+	return 1;
+}
+
+/* place a slot known not to be in the map */
+static inline void hmap_place(struct hmap *m, struct hslot c) {
+	size_t mask = m->cap - 1;
+	size_t idx = c.hash & mask;
+	size_t d = 0;
+	while(1) {
+		struct hslot *s = &m->slots[idx];
+		if(!s->hash) {
+			*s = c;
+			return;
 		}
-		n = n->next;
+		size_t sd = hmap_dist(m, s->hash, idx);
+		if(sd < d) {
+			struct hslot t = *s;
+			*s = c;
+			c = t;
+			d = sd;
+		}
+		idx = (idx + 1) & mask;
+		d++;
 	}
-	return 0;
+}
+
+static inline void hmap_grow(struct hmap *m) {
+	size_t cap = m->cap;
+	struct hslot *slots = m->slots;
+	m->cap = cap << 1;
+	m->slots = malloc(sizeof(struct hslot) * m->cap);
+	memset(m->slots, 0, sizeof(struct hslot) * m->cap);
+	for(size_t i = 0; i < cap; i++) {
+		if(slots[i].hash) hmap_place(m, slots[i]);
+	}
+	free(slots);
 }
 
 static inline int hmap_insert(struct hmap *m, size_t key, void *value) {
-	struct hnode *n = &m->bucket[key % m->bsize];
-	while(n->next) {
-		if(n->next->key == key) {
-			return 0;
-		}
-		n = n->next;
+	if(hmap_find(m, key)) {
+		return 0;
 	}
-	
-	struct hnode *c = malloc(sizeof(struct hnode));
-	c->next = NULL;
-	c->key = key;
-	c->value = value;
-	n->next = c;
+	if((m->count + 1) * HMAP_LOAD_DEN > m->cap * HMAP_LOAD_NUM) {
+		hmap_grow(m);
+	}
+
+	struct hslot c;
+	c.hash = hmap_hash(key);
+	c.key = key;
+	c.value = value;
+	hmap_place(m, c);
 	m->count++;
 	return 1;
 }
 
 static inline int hmap_remove(struct hmap *m, size_t key, void **value) {
-	struct hnode *p = &m->bucket[key % m->bsize];
-	struct hnode *n = p->next;
-	while(n) {
-		if(n->key == key) {
-			if(value) {
-				*value = n->value;
-			}
-			break;
-		}
-		p = n;
-		n = p->next;
-	}
+	struct hslot *s = hmap_find(m, key);
 	//not found
-	if(!n) {
+	if(!s) {
 		return 0;
 	}
-	p->next = n->next;
+	if(value) {
+		*value = s->value;
+	}
+
+	//backward shift the following run
+	size_t mask = m->cap - 1;
+	size_t idx = s - m->slots;
+	size_t next = (idx + 1) & mask;
+	while(m->slots[next].hash && hmap_dist(m, m->slots[next].hash, next) > 0) {
+		m->slots[idx] = m->slots[next];
+		idx = next;
+		next = (next + 1) & mask;
+	}
+	memset(&m->slots[idx], 0, sizeof(struct hslot));
 	m->count--;
-	free(n);
 	return 1;
 }
 
 static inline void hmap_foreach(struct hmap *m, hmap_handler h) {
-	for(size_t i = 0; i < m->bsize; i++) {
-		struct hnode *n = m->bucket[i].next;
-		while(n) {
-			h(n->key, n->value);
-			n = n->next;
-		}
+	for(size_t i = 0; i < m->cap; i++) {
+		struct hslot *s = &m->slots[i];
+		if(s->hash) h(s->key, s->value);
 	}
 }
 
 static inline void hmap_clear(struct hmap *m, hmap_handler h) {
-	for(size_t i = 0; i < m->bsize; i++) {
-		struct hnode *n = m->bucket[i].next;
-		while(n) {
-			struct hnode *c = n;
-			n = n->next;
-			h(c->key, c->value);
-			free(c);
-		}
+	for(size_t i = 0; i < m->cap && h; i++) {
+		struct hslot *s = &m->slots[i];
+		if(s->hash) h(s->key, s->value);
 	}
-	free(m->bucket);
-	m->bsize = 0;
+	free(m->slots);
+	m->slots = NULL;
+	m->cap = 0;
 	m->count = 0;
 }
 
@@ -0,0 +1,44 @@
+#include "fox.h"
+#include "symbol.h"
+#include "syntax.h"
+#include "output.h"
+#include "translator.h"
+
+#ifdef DEBUG
+int log_level = LOG_DEBUG;
+#else
+int log_level = LOG_MSG;
+#endif
+
+__thread FILE *log_fp = NULL;
+
+struct fox_options fox_options = {
+	1,		/* fold */
+	0,		/* minify */
+	10 * 1024,	/* json_min */
+};
+
+int fox_options_key(char *buf, size_t len) {
+	return snprintf(buf, len, "fold=%d,json=%d,min=%d",
+					fox_options.fold, fox_options.json_min, fox_options.minify);
+}
+
+int fox_translate_buffer(const char *src, size_t len, struct fox_output *out) {
+	struct syntax_tree *tree = NULL;
+	struct symbol_table *table = NULL;
+	if(!parse_buffer("<buffer>", src, len, &tree, &table)) {
+		syntax_tree_trim();
+		return 0;
+	}
+
+	int val = translate_output(out, tree, table);
+	syntax_tree_release(tree);
+	symbol_table_release(table);
+	//the caller's threads never trim, keep no spare tree behind
+	syntax_tree_trim();
+	if(!val) {
+		log_error("translate lua buffer failed");
+		return 0;
+	}
+	return 1;
+}
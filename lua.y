@@ -2,17 +2,24 @@
 #include "fox.h"
 #include "symbol.h"
 #include "syntax.h"
+#include "translator.h"
+#include "stats.h"
 
-int yylex(void);
+union YYSTYPE;
+int yylex(union YYSTYPE *lvalp, void *scanner);
+int yyget_lineno(void *scanner);
 
-extern char yyfilename[];
-extern int yylineno;
-extern char *yytext;
+/* every token goes through parse_lex, which times the lexer for --stats */
+static int parse_lex(union YYSTYPE *lvalp, void *scanner, struct parse_context *ctx);
+#define yylex(lvalp, scanner) parse_lex(lvalp, scanner, ctx)
 
 #ifdef DEBUG
 #define YYDEBUG 1
 #endif
 
+/* nesting is bounded by memory, the parser stack grows on the heap */
+#define YYMAXDEPTH (1 << 24)
+
 #if YYDEBUG
 int yydebug = 1;
 typedef union YYSTYPE YYSTYPE;
@@ -20,162 +27,18 @@ void yyprint(FILE *file, int type, YYSTYPE value);
 #define YYPRINT(file, type, value)   yyprint(file, type, value)
 #endif
 
-#define yyinfo(msg) log_info("%s:%d, %s\n", yyfilename, yylineno, (msg))
-#define yyerror(msg) log_error("%s:%d, %s\n", yyfilename, yylineno, (msg))
-
-struct syntax_tree *parse_tree = NULL;
-struct symbol_table *parse_table = NULL;
-
-void gen_block_symtable(struct syntax_block *block);
-void gen_node_symtable(struct syntax_block *b, struct syntax_node *n);
-
-void gen_stmt_symtable(struct syntax_block *b, struct syntax_statement *stmt) {
-	struct syntax_node *c = stmt->n.children;
-	switch(stmt->tag) {
-	case STMT_LOCAL_VAR:
-	{
-		char *p = stmt->value.name;
-		int start = 0;
-		int end = 0;
-		while(p[end] != '\0') {
-			while(p[end] != ',' && p[end] != '\0') end++;
-
-			char tmp[end - start + 1];
-			memset(tmp, 0, end - start + 1);
-			strncpy(tmp, p + start, end - start);
-			char *name = fox_strcat("lv_", tmp);
-
-			struct symbol *s = symbol_create(name, &stmt->n);
-			free(name);
-			symbol_table_insert(b->symtab, s);
-			
-			if(p[end] == '\0') break;
-			end++;
-			start = end;
-		}
-
-		c = stmt->n.children;
-		while(c) {
-			gen_node_symtable(b, c);
-			c = c->next;
-		}
-		break;
-	}
-	case STMT_VAR:
-	{
-		if(chunk_scope(&stmt->n)) {
-			c = stmt->n.children;
-			while(c && c->type == STX_VARIABLE) {
-				struct syntax_variable *v = (struct syntax_variable *)c;
-				if(v->tag == VAR_NORMAL) {
-					char *name = fox_strcat("v_", v->name);
-					struct symbol *s = symbol_create(name, c);
-					free(name);
-					symbol_table_insert(b->symtab, s);
-				}
-				c = c->next;
-			}
-		} else {
-			c = stmt->n.children;
-			while(c && c->type == STX_VARIABLE) {
-				struct syntax_variable *v = (struct syntax_variable *)c;
-				if(v->tag == VAR_NORMAL) {
-					char *name1 = fox_strcat("v_", v->name);
-					char *name2 = fox_strcat("lv_", v->name);
-					bool found = FALSE;
-					struct syntax_block *cb = b;
-					while(cb) {
-						struct symbol *cs1 = symbol_table_get(cb->symtab, name1);
-						struct symbol *cs2 = symbol_table_get(cb->symtab, name2);
-						if(cs1 || cs2) { found = TRUE; break; }
-						struct syntax_node *cp = cb->n.parent;
-						while(cp && cp->type != STX_BLOCK) cp = cp->parent;
-						if(!cp) break;
-						cb = (struct syntax_block *)cp;
-					}
-
-					if(!found) {
-						struct symbol *s = symbol_create(name1, c);
-						symbol_table_insert(b->symtab, s);						
-					}
-					free(name1);
-					free(name2);
-				}
-				c = c->next;
-			}
-		}
+#define yyinfo(scanner, ctx, msg) log_info("%s:%d, %s\n", (ctx)->filename, yyget_lineno(scanner), (msg))
+#define yyerror(scanner, ctx, msg) log_error("%s:%d, %s\n", (ctx)->filename, yyget_lineno(scanner), (msg))
 
-		c = stmt->n.children;
-		while(c) {
-			gen_node_symtable(b, c);
-			c = c->next;
-		}
-		break;
-	}
-	case STMT_FUNC:
-	{
-		struct syntax_function *func = (struct syntax_function *)c;
-		if(func->name && !strstr(func->name, ".") && !strstr(func->name, ":")) {
-			char * name = fox_strcat("f_", func->name);
-			struct symbol *s = symbol_create(name, c);
-			free(name);
-			symbol_table_insert(b->symtab, s);
-		}
-		gen_node_symtable(b, stmt->n.children);
-		break;
-	}
-	case STMT_LOCAL_FUNC:
-	{
-		struct syntax_function *func = (struct syntax_function *)c;
-		if(func->name && !strstr(func->name, ".") && !strstr(func->name, ":")) {
-			char * name = fox_strcat("lf_", func->name);
-			struct symbol *s = symbol_create(name, c);
-			free(name);
-			symbol_table_insert(b->symtab, s);
-		}
-		gen_node_symtable(b, stmt->n.children);
-		break;
-	}
-	default:
-		c = stmt->n.children;
-		while(c) {
-			gen_node_symtable(b, c);
-			c = c->next;
-		}
-	}
-}
-
-void gen_node_symtable(struct syntax_block *b, struct syntax_node *n) {
-	struct syntax_node *c = n->children;
-	switch(n->type)
-	{
-	case STX_BLOCK:
-		gen_block_symtable((struct syntax_block *)n);
-		break;
-	case STX_STATEMENT:
-		gen_stmt_symtable(b, (struct syntax_statement *)n);
-		break;
-	default:
-		while(c) {
-			gen_node_symtable(b, c);
-			c = c->next;
-		}
-	}
-}
-
-void gen_block_symtable(struct syntax_block *block) {
-	struct syntax_node *c = block->n.children;
-	while(c) {
-		gen_node_symtable(block, c);
-		c = c->next;
-	}
-}
+%}
 
-void gen_chunk_symtables(struct syntax_chunk *chunk) {
-	gen_block_symtable((struct syntax_block *)chunk->n.children);
+%code requires {
+struct parse_context;
 }
 
-%}
+%define api.pure full
+%lex-param				{ void *scanner }
+%parse-param			{ void *scanner } { struct parse_context *ctx }
 
 %union {
 	int integer;
@@ -203,7 +66,7 @@ void gen_chunk_symtables(struct syntax_chunk *chunk) {
 %token					AND OR GE LE EQ NE CONC DOTS LSHIFT RSHIFT FDIV
 
 %token<string>			NAME STRING
-%token<string>			NUMBER
+%token<exp>				NUMBER
 
 %type<chunk>			chunk
 %type<block>			block
@@ -240,43 +103,42 @@ void gen_chunk_symtables(struct syntax_chunk *chunk) {
 
 program:		chunk
 				{
-					parse_tree->root = &($1->n);
-					gen_chunk_symtables($1);
+					ctx->tree->root = &($1->n);
 				}
 		;
 
 chunk:			block
 				{
-					struct syntax_chunk *chunk = create_syntax_chunk();
+					struct syntax_chunk *chunk = create_syntax_chunk(ctx->tree);
 					syntax_node_push_child_tail(&chunk->n, &($1->n));
-					chunk->n.lineno = yylineno;
+					chunk->n.lineno = yyget_lineno(scanner);
 					$$ = chunk;
 				}
 		;
 
 block:			/* empty */
 				{
-					$$ = create_syntax_block();
-					$$->n.lineno = yylineno;
+					$$ = create_syntax_block(ctx->tree);
+					$$->n.lineno = yyget_lineno(scanner);
 				}
 		|		retstmt
 				{
-					struct syntax_block *block = create_syntax_block();
-					block->n.lineno = yylineno;
+					struct syntax_block *block = create_syntax_block(ctx->tree);
+					block->n.lineno = yyget_lineno(scanner);
 					syntax_node_push_child_tail(&block->n, &($1->n));
 					$$ = block;
 				}
 		|		stmtlist
 				{
-					struct syntax_block *block = create_syntax_block();
-					block->n.lineno = yylineno;
+					struct syntax_block *block = create_syntax_block(ctx->tree);
+					block->n.lineno = yyget_lineno(scanner);
 					syntax_node_push_child_tail(&block->n, &($1->n));
 					$$ = block;
 				}
 		|		stmtlist retstmt
 				{
-					struct syntax_block *block = create_syntax_block();
-					block->n.lineno = yylineno;
+					struct syntax_block *block = create_syntax_block(ctx->tree);
+					block->n.lineno = yyget_lineno(scanner);
 					syntax_node_push_child_tail(&block->n, &($1->n));
 					syntax_node_push_child_tail(&block->n, &($2->n));
 					$$ = block;
@@ -300,15 +162,15 @@ stmt:			basestmt
 
 retstmt:		RETURN retend
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_RETURN;
 					$$ = stmt;
 				}
 		|		RETURN explist retend
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_RETURN;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					$$ = stmt;
@@ -321,38 +183,38 @@ retend:			/* empty */
 
 basestmt:		';'
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_EMPTY;
 					$$ = stmt;
 				}
 		|		label
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_LABEL;
 					stmt->value.name = $1;
 					$$ = stmt;
 				}
 		|		BREAK
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_BREAK;
 					$$ = stmt;
 				}
 		|		GOTO NAME
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_GOTO;
 					stmt->value.name = $2;
 					$$ = stmt;			
 				}
 		|		DO block END
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_DO;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					$$ = stmt;
@@ -361,8 +223,8 @@ basestmt:		';'
 
 loopstmt:		WHILE exp DO block END
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_WHILE;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -370,8 +232,8 @@ loopstmt:		WHILE exp DO block END
 				}
 		|		REPEAT block UNTIL exp
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_REPEAT;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -379,8 +241,8 @@ loopstmt:		WHILE exp DO block END
 				}
 		|		FOR namelist IN explist DO block END
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_FOR_IN;
 					stmt->value.name = $2;
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -389,8 +251,8 @@ loopstmt:		WHILE exp DO block END
 				}
 		|		FOR NAME '=' exp ',' exp ',' exp DO block END
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_FOR_IT;
 					stmt->value.name = $2;
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -401,8 +263,8 @@ loopstmt:		WHILE exp DO block END
 				}
 		|		FOR NAME '=' exp ',' exp DO block END
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_FOR_IT;
 					stmt->value.name = $2;
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -414,8 +276,8 @@ loopstmt:		WHILE exp DO block END
 
 ifstmt:			IF exp THEN block elsestmt END
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_IF;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -426,23 +288,23 @@ ifstmt:			IF exp THEN block elsestmt END
 
 elsestmt:		/* empty */
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_EMPTY;
 					$$ = stmt;
 				}
 		|		ELSE block
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_ELSE;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					$$ = stmt;		
 				}
 		|		ELSEIF exp THEN block elsestmt
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_ELSEIF;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -453,16 +315,16 @@ elsestmt:		/* empty */
 
 varstmt:		LOCAL namelist
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_LOCAL_VAR;
 					stmt->value.name = $2;
 					$$ = stmt;
 				}
 		|		LOCAL namelist '=' explist
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_LOCAL_VAR;
 					stmt->value.name = $2;
 					syntax_node_push_child_tail(&stmt->n, &($4->n));
@@ -470,8 +332,8 @@ varstmt:		LOCAL namelist
 				}
 		|		varlist '=' explist
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_VAR;
 					syntax_node_push_child_tail(&stmt->n, &($1->n));
 					syntax_node_push_child_tail(&stmt->n, &($3->n));
@@ -482,24 +344,24 @@ varstmt:		LOCAL namelist
 funcstmt:		/* funcall will lead to reduce/reduce conflict */
 				prefixexp
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_FCALL;
 					syntax_node_push_child_tail(&stmt->n, &($1->n));
 					$$ = stmt;
 				}
 		|		funcdef
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_FUNC;
 					syntax_node_push_child_tail(&stmt->n, &($1->n));
 					$$ = stmt;
 				}
 		|		LOCAL funcdef
 				{
-					struct syntax_statement *stmt = create_syntax_statement();
-					stmt->n.lineno = yylineno;
+					struct syntax_statement *stmt = create_syntax_statement(ctx->tree);
+					stmt->n.lineno = yyget_lineno(scanner);
 					stmt->tag = STMT_LOCAL_FUNC;
 					syntax_node_push_child_tail(&stmt->n, &($2->n));
 					$$ = stmt;
@@ -515,12 +377,7 @@ label:			LABEL NAME LABEL
 namelist:		NAME
 		|		namelist ',' NAME
 				{
-					char *s0 = fox_strcat($1, ",");
-					char *s1 = fox_strcat(s0, $3);
-					free($1);
-					free($3);
-					free(s0);
-					$$ = s1;					
+					$$ = syntax_tree_strjoin(ctx->tree, $1, ",", $3);					
 				}
 		;
 
@@ -541,24 +398,24 @@ exp:			prefixexp
 
 prefixexp:		var
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_VAR;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					$$ = exp;
 				}
 		|		funcall
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_FCALL;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					$$ = exp;
 				}
 		|		'(' exp ')'
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_PARENTHESIS;
 					syntax_node_push_child_tail(&exp->n, &($2->n));
 					$$ = exp;
@@ -568,45 +425,42 @@ prefixexp:		var
 
 constexp:		NIL
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_NIL;
 					$$ = exp;
 				}
 		|		BTRUE
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_TRUE;
 					$$ = exp;
 				}
 		|		BFALSE
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_FALSE;
 					$$ = exp;
 				}
 		|		NUMBER
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
-					exp->tag = EXP_NUMBER;
-					exp->value.string = $1;
-					$$ = exp;					
+					$1->n.lineno = yyget_lineno(scanner);
+					$$ = $1;
 				}
 		|		STRING
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_STRING;
 					exp->value.string = $1;
 					$$ = exp;
 				}
 		|		DOTS
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_DOTS;
 					$$ = exp;					
 				}
@@ -614,8 +468,8 @@ constexp:		NIL
 
 primaryexp:		exp '+' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_ADD;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -623,8 +477,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '-' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_SUB;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -632,8 +486,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '*' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_MUL;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -641,8 +495,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '/' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_DIV;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -650,8 +504,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp FDIV exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_FDIV;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -659,8 +513,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '^' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_EXP;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -668,8 +522,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '%' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_MOD;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -677,8 +531,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '&' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_BAND;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -686,8 +540,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '|' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_BOR;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -695,8 +549,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '~' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_XOR;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -704,8 +558,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp LSHIFT exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_LSHIFT;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -713,8 +567,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp RSHIFT exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_RSHIFT;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -722,8 +576,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp CONC exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_CONC;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -731,8 +585,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '<' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_LESS;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -740,8 +594,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp '>' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_GREATER;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -749,8 +603,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp LE exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_LE;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -758,8 +612,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp GE exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_GE;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -767,8 +621,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp EQ exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_EQ;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -776,8 +630,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp NE exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_NE;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -785,8 +639,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp AND exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_AND;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -794,8 +648,8 @@ primaryexp:		exp '+' exp
 				}
 		|		exp OR exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_OR;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					syntax_node_push_child_tail(&exp->n, &($3->n));
@@ -803,32 +657,32 @@ primaryexp:		exp '+' exp
 				}
 		|		'~' exp %prec OPBNOT
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_BNOT;
 					syntax_node_push_child_tail(&exp->n, &($2->n));
 					$$ = exp;
 				}
 		|		'-' exp %prec OPNEG
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_NEG;
 					syntax_node_push_child_tail(&exp->n, &($2->n));
 					$$ = exp;
 				}
 		|		NOT exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_NOT;
 					syntax_node_push_child_tail(&exp->n, &($2->n));
 					$$ = exp;
 				}
 		|		'#' exp
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_LEN;
 					syntax_node_push_child_tail(&exp->n, &($2->n));
 					$$ = exp;
@@ -837,8 +691,8 @@ primaryexp:		exp '+' exp
 
 funcexp:		funclambda
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_FUNC;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					$$ = exp;
@@ -847,8 +701,8 @@ funcexp:		funclambda
 
 tableexp:		table
 				{
-					struct syntax_expression *exp = create_syntax_expression();
-					exp->n.lineno = yylineno;
+					struct syntax_expression *exp = create_syntax_expression(ctx->tree);
+					exp->n.lineno = yyget_lineno(scanner);
 					exp->tag = EXP_TABLE;
 					syntax_node_push_child_tail(&exp->n, &($1->n));
 					$$ = exp;
@@ -865,16 +719,16 @@ varlist:		var
 
 var:			NAME
 				{
-					struct syntax_variable *var = create_syntax_variable();
-					var->n.lineno = yylineno;
+					struct syntax_variable *var = create_syntax_variable(ctx->tree);
+					var->n.lineno = yyget_lineno(scanner);
 					var->tag = VAR_NORMAL;
 					var->name = $1;
 					$$ = var;
 				}
 		|		prefixexp '[' exp ']'
 				{
-					struct syntax_variable *var = create_syntax_variable();
-					var->n.lineno = yylineno;
+					struct syntax_variable *var = create_syntax_variable(ctx->tree);
+					var->n.lineno = yyget_lineno(scanner);
 					var->tag = VAR_INDEX;
 					syntax_node_push_child_tail(&var->n, &($1->n));
 					syntax_node_push_child_tail(&var->n, &($3->n));
@@ -882,8 +736,8 @@ var:			NAME
 				}
 		|		prefixexp '.' NAME
 				{
-					struct syntax_variable *var = create_syntax_variable();
-					var->n.lineno = yylineno;
+					struct syntax_variable *var = create_syntax_variable(ctx->tree);
+					var->n.lineno = yyget_lineno(scanner);
 					var->tag = VAR_KEY;
 					syntax_node_push_child_tail(&var->n, &($1->n));
 					var->name = $3;
@@ -907,38 +761,28 @@ funclambda:		FUNCTION funcbody
 basefuncname:	NAME
 		|		basefuncname '.' NAME
 				{
-					char *s0 = fox_strcat($1, ".");
-					char *s1 = fox_strcat(s0, $3);
-					free($1);
-					free($3);
-					free(s0);
-					$$ = s1;
+					$$ = syntax_tree_strjoin(ctx->tree, $1, ".", $3);
 				}
 		;
 
 funcname:		basefuncname
 		|		basefuncname ':' NAME
 				{
-					char *s0 = fox_strcat($1, ":");
-					char *s1 = fox_strcat(s0, $3);
-					free($1);
-					free($3);
-					free(s0);
-					$$ = s1;
+					$$ = syntax_tree_strjoin(ctx->tree, $1, ":", $3);
 				}
 		;
 
 funcbody:		'(' ')' block END
 				{
-					struct syntax_function *func = create_syntax_function();
-					func->n.lineno = yylineno;
+					struct syntax_function *func = create_syntax_function(ctx->tree);
+					func->n.lineno = yyget_lineno(scanner);
 					syntax_node_push_child_tail(&func->n, &($3->n));
 					$$ = func;
 				}
 		|		'(' parlist ')' block END
 				{
-					struct syntax_function *func = create_syntax_function();
-					func->n.lineno = yylineno;
+					struct syntax_function *func = create_syntax_function(ctx->tree);
+					func->n.lineno = yyget_lineno(scanner);
 					func->pars = $2;
 					syntax_node_push_child_tail(&func->n, &($4->n));
 					$$ = func;
@@ -948,30 +792,26 @@ funcbody:		'(' ')' block END
 parlist:		namelist
 		|		namelist ',' DOTS
 				{
-					char *s0 = fox_strcat($1, ",");
-					char *s1 = fox_strcat(s0, "...");
-					free($1);
-					free(s0);
-					$$ = s1;
+					$$ = syntax_tree_strjoin(ctx->tree, $1, ",", "...");
 				}
 		|		DOTS
 				{
-					$$ = fox_strdup("...");
+					$$ = syntax_tree_strdup(ctx->tree, "...");
 				}
 		;
 
 funcall:		prefixexp arglist
 				{
-					struct syntax_functioncall *fcall = create_syntax_functioncall();
-					fcall->n.lineno = yylineno;
+					struct syntax_functioncall *fcall = create_syntax_functioncall(ctx->tree);
+					fcall->n.lineno = yyget_lineno(scanner);
 					syntax_node_push_child_tail(&fcall->n, &($1->n));
 					syntax_node_push_child_tail(&fcall->n, &($2->n));
 					$$ = fcall;
 				}
 		|		prefixexp ':' NAME arglist
 				{
-					struct syntax_functioncall *fcall = create_syntax_functioncall();
-					fcall->n.lineno = yylineno;
+					struct syntax_functioncall *fcall = create_syntax_functioncall(ctx->tree);
+					fcall->n.lineno = yyget_lineno(scanner);
 					fcall->name = $3;
 					syntax_node_push_child_tail(&fcall->n, &($1->n));
 					syntax_node_push_child_tail(&fcall->n, &($4->n));
@@ -980,31 +820,31 @@ funcall:		prefixexp arglist
 
 arglist:		'(' ')'
 				{
-					struct syntax_argument *arg = create_syntax_argument();
-					arg->n.lineno = yylineno;
+					struct syntax_argument *arg = create_syntax_argument(ctx->tree);
+					arg->n.lineno = yyget_lineno(scanner);
 					arg->tag = ARG_EMPTY;
 					$$ = arg;
 				}
 		|		'(' explist ')'
 				{
-					struct syntax_argument *arg = create_syntax_argument();
-					arg->n.lineno = yylineno;
+					struct syntax_argument *arg = create_syntax_argument(ctx->tree);
+					arg->n.lineno = yyget_lineno(scanner);
 					arg->tag = ARG_NORMAL;
 					syntax_node_push_child_tail(&arg->n, &($2->n));
 					$$ = arg;
 				}
 		|		STRING
 				{
-					struct syntax_argument *arg = create_syntax_argument();
-					arg->n.lineno = yylineno;
+					struct syntax_argument *arg = create_syntax_argument(ctx->tree);
+					arg->n.lineno = yyget_lineno(scanner);
 					arg->tag = ARG_STRING;
 					arg->name = $1;
 					$$ = arg;		
 				}
 		|		table
 				{
-					struct syntax_argument *arg = create_syntax_argument();
-					arg->n.lineno = yylineno;
+					struct syntax_argument *arg = create_syntax_argument(ctx->tree);
+					arg->n.lineno = yyget_lineno(scanner);
 					arg->tag = ARG_TABLE;
 					syntax_node_push_child_tail(&arg->n, &($1->n));
 					$$ = arg;					
@@ -1013,15 +853,15 @@ arglist:		'(' ')'
 
 table:			'{' fieldlist '}'
 				{
-					struct syntax_table *t = create_syntax_table();
-					t->n.lineno = yylineno;
+					struct syntax_table *t = create_syntax_table(ctx->tree);
+					t->n.lineno = yyget_lineno(scanner);
 					syntax_node_push_child_tail(&(t->n), &($2->n));
 					$$ = t;
 				}
 		|		'{' '}'
 				{
-					struct syntax_table *t = create_syntax_table();
-					t->n.lineno = yylineno;
+					struct syntax_table *t = create_syntax_table(ctx->tree);
+					t->n.lineno = yyget_lineno(scanner);
 					$$ = t;
 				}
 		;
@@ -1040,8 +880,8 @@ fieldlist:		field
 
 field:			'[' exp ']' '=' exp
 				{
-					struct syntax_field * f = create_syntax_field();
-					f->n.lineno = yylineno;
+					struct syntax_field * f = create_syntax_field(ctx->tree);
+					f->n.lineno = yyget_lineno(scanner);
 					f->tag = FIELD_INDEX;
 					syntax_node_push_child_tail(&f->n, &($2->n));	
 					syntax_node_push_child_tail(&f->n, &($5->n));
@@ -1049,8 +889,8 @@ field:			'[' exp ']' '=' exp
 				}
 		|		NAME '=' exp
 				{
-					struct syntax_field * f = create_syntax_field();
-					f->n.lineno = yylineno;
+					struct syntax_field * f = create_syntax_field(ctx->tree);
+					f->n.lineno = yyget_lineno(scanner);
 					f->tag = FIELD_KEY;
 					f->name = $1;
 					syntax_node_push_child_tail(&f->n, &($3->n));
@@ -1058,8 +898,8 @@ field:			'[' exp ']' '=' exp
 				}
 		|		exp
 				{
-					struct syntax_field * f = create_syntax_field();
-					f->n.lineno = yylineno;
+					struct syntax_field * f = create_syntax_field(ctx->tree);
+					f->n.lineno = yyget_lineno(scanner);
 					f->tag = FIELD_SINGLE;
 					syntax_node_push_child_tail(&f->n, &($1->n));
 					$$ = f;					
@@ -1077,7 +917,7 @@ void yyprint(FILE *file, int type, YYSTYPE value)
 {
 	switch(type) {
 	case NUMBER:
-		fprintf(file, "\n[YACC]%s, %s\n", "number", value.string);
+		fprintf(file, "\n[YACC]%s, %s\n", "number", value.exp->value.string);
 		break;
 	case STRING:
 		fprintf(file, "\n[YACC]%s, %s\n", "string", value.string);
@@ -1091,3 +931,13 @@ void yyprint(FILE *file, int type, YYSTYPE value)
 	}
 }
 #endif
+
+#undef yylex
+static int parse_lex(union YYSTYPE *lvalp, void *scanner, struct parse_context *ctx) {
+	if(!ctx->stats) return yylex(lvalp, scanner);
+	double t = stats_now();
+	int token = yylex(lvalp, scanner);
+	ctx->stats->lex += stats_now() - t;
+	ctx->stats->tokens++;
+	return token;
+}
@@ -0,0 +1,92 @@
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "fox.h"
+#include "output.h"
+
+void output_init(struct fox_output *o) {
+	o->data = NULL;
+	o->len = 0;
+	o->cap = 0;
+}
+
+void output_release(struct fox_output *o) {
+	free(o->data);
+	output_init(o);
+}
+
+/* make room for n more bytes plus a terminating zero */
+void output_reserve(struct fox_output *o, size_t n) {
+	if(o->len + n < o->cap) return;
+	size_t cap = o->cap ? o->cap : OUTPUT_INIT_CAP;
+	while(o->len + n >= cap) cap *= 2;
+	o->data = realloc(o->data, cap);
+	o->cap = cap;
+}
+
+void output_truncate(struct fox_output *o, size_t len) {
+	if(len < o->len) o->len = len;
+}
+
+/* shortest text that reads back as d, d must be finite */
+int output_format_double(char *buf, size_t len, double d) {
+	if(d == floor(d) && fabs(d) < 1e15) return snprintf(buf, len, "%.0f", d);
+	int l = 0;
+	for(int p = 1; p <= 17; p++) {
+		l = snprintf(buf, len, "%.*g", p, d);
+		if(strtod(buf, NULL) == d) break;
+	}
+	return l;
+}
+
+void emit_fmt(struct fox_output *o, const char *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	size_t room = o->cap - o->len;
+	int n = o->data ? vsnprintf(o->data + o->len, room, fmt, ap) : -1;
+	va_end(ap);
+	if(n >= 0 && (size_t)n < room) {
+		o->len += n;
+		return;
+	}
+
+	if(n < 0) {
+		va_start(ap, fmt);
+		n = vsnprintf(NULL, 0, fmt, ap);
+		va_end(ap);
+		if(n < 0) return;
+	}
+	output_reserve(o, n);
+	va_start(ap, fmt);
+	vsnprintf(o->data + o->len, o->cap - o->len, fmt, ap);
+	va_end(ap);
+	o->len += n;
+}
+
+int output_write_fd(struct fox_output *o, int fd) {
+	size_t off = 0;
+	while(off < o->len) {
+		ssize_t n = write(fd, o->data + off, o->len - off);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			log_error("write output failed: %s", strerror(errno));
+			return 0;
+		}
+		off += n;
+	}
+	return 1;
+}
+
+int output_write_file(struct fox_output *o, const char *filename) {
+	int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		log_error("open file failed %s", filename);
+		return 0;
+	}
+	int val = output_write_fd(o, fd);
+	if(close(fd)) val = 0;
+	return val;
+}
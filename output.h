@@ -0,0 +1,42 @@
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <stddef.h>
+#include <string.h>
+
+/* growable in-memory output, written out in one go when done */
+struct fox_output {
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+#define OUTPUT_INIT_CAP (16 * 1024)
+
+void output_init(struct fox_output *o);
+void output_release(struct fox_output *o);
+void output_reserve(struct fox_output *o, size_t n);
+void output_truncate(struct fox_output *o, size_t len);
+int output_write_fd(struct fox_output *o, int fd);
+int output_write_file(struct fox_output *o, const char *filename);
+
+int output_format_double(char *buf, size_t len, double d);
+
+void emit_fmt(struct fox_output *o, const char *fmt, ...);
+
+static inline void emit_char(struct fox_output *o, char c) {
+	if(o->len + 1 >= o->cap) output_reserve(o, 1);
+	o->data[o->len++] = c;
+}
+
+static inline void emit_strn(struct fox_output *o, const char *s, size_t l) {
+	if(o->len + l >= o->cap) output_reserve(o, l);
+	memcpy(o->data + o->len, s, l);
+	o->len += l;
+}
+
+static inline void emit_str(struct fox_output *o, const char *s) {
+	emit_strn(o, s, strlen(s));
+}
+
+#endif
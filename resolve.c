@@ -0,0 +1,512 @@
+#include "fox.h"
+#include "hmap.h"
+#include "symbol.h"
+#include "syntax.h"
+#include "translator.h"
+
+/*
+ * scope resolution in one pre-order pass. the visible names sit on a
+ * stack, innermost last, and a map keyed on the interned name pointer
+ * holds the innermost one, each var remembers the one it shadows.
+ * globals assigned in a scope are kept on the stack as well, that is
+ * how the block symbol tables learn about a name only once.
+ *
+ * under --minify the locals of nested scopes are renamed as they are
+ * declared, the k-th live local gets the k-th short name. two locals
+ * visible at once never share a name, and a name that shows up anywhere
+ * in the chunk is never made, so no global gets shadowed. the locals of
+ * the chunk block keep their names, they are exported.
+ *
+ * a local function stays direct while every use of its name is a plain
+ * call, those calls learn their callee. the translator passes the extra
+ * return values of a direct function through a register, see nrets.
+ */
+
+#define RESOLVE_GLOBAL (-1)
+
+struct resolve_var {
+	const char *name;
+	int func;		/* depth of the declaring function, RESOLVE_GLOBAL for globals */
+	int slot;
+	size_t shadow;	/* index + 1 of the var with the same name below, 0 if none */
+	int index;		/* position among the renamed locals, -1 if kept */
+	char *alias;	/* name in the output */
+	struct syntax_function *lfunc;	/* the local function it names */
+};
+
+struct resolve_scope {
+	struct syntax_block *block;
+	size_t base;	/* first var of the scope */
+	int slots;		/* locals of the function live at scope entry */
+};
+
+struct resolver {
+	struct syntax_tree *t;
+	struct hmap names;	/* name -> index + 1 of the innermost var */
+	struct resolve_var *vars;
+	size_t nvars;
+	size_t vars_cap;
+	struct resolve_scope *scopes;
+	size_t nscopes;
+	size_t scopes_cap;
+	int *saved;		/* slot counters of the enclosing functions */
+	int depth;		/* function depth, 0 is the chunk */
+	int saved_cap;
+	int slots;		/* locals live in the current function */
+	int minify;
+	const char *self;
+	int live;		/* renamed locals in scope */
+	char **aliases;	/* short names in the order they are handed out */
+	int naliases;
+	int aliases_cap;
+	unsigned mangle;	/* next short name to try */
+};
+
+static void resolver_init(struct resolver *r, struct syntax_tree *t) {
+	r->t = t;
+	hmap_init(&r->names, 64);
+	r->vars_cap = 64;
+	r->vars = malloc(r->vars_cap * sizeof(struct resolve_var));
+	r->nvars = 0;
+	r->scopes_cap = 16;
+	r->scopes = malloc(r->scopes_cap * sizeof(struct resolve_scope));
+	r->nscopes = 0;
+	r->saved_cap = 16;
+	r->saved = malloc(r->saved_cap * sizeof(int));
+	r->depth = 0;
+	r->slots = 0;
+	r->minify = fox_options.minify;
+	r->self = strpool_intern_str(&t->strings, "self");
+	r->live = 0;
+	r->aliases = NULL;
+	r->naliases = 0;
+	r->aliases_cap = 0;
+	r->mangle = 0;
+}
+
+static void resolver_release(struct resolver *r) {
+	hmap_clear(&r->names, NULL);
+	free(r->vars);
+	free(r->scopes);
+	free(r->saved);
+	free(r->aliases);
+}
+
+static struct resolve_var *resolver_push(struct resolver *r, const char *name, int func, int slot) {
+	if(r->nvars == r->vars_cap) {
+		r->vars_cap *= 2;
+		r->vars = realloc(r->vars, r->vars_cap * sizeof(struct resolve_var));
+	}
+	size_t idx = r->nvars++;
+	struct resolve_var *v = &r->vars[idx];
+	v->name = name;
+	v->func = func;
+	v->slot = slot;
+	v->index = -1;
+	v->alias = (char *)name;
+	v->lfunc = NULL;
+	struct hslot *hs = hmap_find(&r->names, HKEY_PTR(name));
+	if(hs) {
+		v->shadow = (size_t)hs->value;
+		hs->value = HVALUE(idx + 1);
+	} else {
+		v->shadow = 0;
+		hmap_insert(&r->names, HKEY_PTR(name), HVALUE(idx + 1));
+	}
+	return v;
+}
+
+/* drop the vars of a closed scope, uncovering what they shadowed */
+static void resolver_pop(struct resolver *r, size_t base) {
+	while(r->nvars > base) {
+		struct resolve_var *v = &r->vars[--r->nvars];
+		if(v->index >= 0) r->live--;
+		if(v->lfunc && v->lfunc->direct && v->lfunc->nrets > 1 && v->lfunc->nrets > r->t->regs) {
+			r->t->regs = v->lfunc->nrets;
+		}
+		if(v->shadow) {
+			hmap_find(&r->names, HKEY_PTR(v->name))->value = HVALUE(v->shadow);
+		} else {
+			hmap_remove(&r->names, HKEY_PTR(v->name), NULL);
+		}
+	}
+}
+
+/* js words and the names the translator writes itself */
+static const char *resolve_words[] = {
+	"do", "if", "in", "for", "fox", "let", "new", "try", "var", "nil", "NaN", "rtmp",
+	"case", "else", "enum", "eval", "null", "self", "step", "this", "true",
+	"void", "with", "ftmp", "stmp", "vtmp", "vs", "Math", "JSON",
+	"await", "break", "catch", "class", "const", "false", "super", "throw",
+	"while", "yield", "limit", "value", "delete", "export", "import",
+	"public", "return", "static", "switch", "typeof", "module", "exports",
+	"require", "default", "extends", "finally", "package", "private",
+	"retvals", "continue", "debugger", "function", "Infinity", "arguments",
+	"varargs", "interface", "protected", "undefined", "implements", "instanceof",
+	NULL
+};
+
+static int resolver_reserved(const char *s) {
+	for(const char **w = resolve_words; *w; w++) {
+		if(!strcmp(*w, s)) return 1;
+	}
+	return 0;
+}
+
+/* n-th identifier in order of length */
+static int resolver_mangle_name(unsigned n, char *buf) {
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_$0123456789";
+	int l = 0;
+	buf[l++] = chars[n % 54];
+	n /= 54;
+	while(n) {
+		n--;
+		buf[l++] = chars[n % 64];
+		n /= 64;
+	}
+	buf[l] = '\0';
+	return l;
+}
+
+static char *resolver_short_name(struct resolver *r) {
+	char buf[16];
+	while(1) {
+		int l = resolver_mangle_name(r->mangle++, buf);
+		if(!strpool_find(&r->t->strings, buf, l) && !resolver_reserved(buf)) {
+			return strpool_intern(&r->t->strings, buf, l);
+		}
+	}
+}
+
+static struct resolve_var *resolver_local(struct resolver *r, const char *name) {
+	int slot = r->slots++;
+	struct resolve_var *v = resolver_push(r, name, r->depth, slot);
+	if(!r->minify || r->nscopes < 2 || name == r->self) return v;
+
+	v->index = r->live++;
+	if(v->index == r->naliases) {
+		if(r->naliases == r->aliases_cap) {
+			r->aliases_cap = r->aliases_cap ? r->aliases_cap * 2 : 32;
+			r->aliases = realloc(r->aliases, r->aliases_cap * sizeof(char *));
+		}
+		r->aliases[r->naliases++] = resolver_short_name(r);
+	}
+	v->alias = r->aliases[v->index];
+	return v;
+}
+
+static struct resolve_var *resolver_find(struct resolver *r, const char *name) {
+	void *idx = NULL;
+	if(!hmap_get(&r->names, HKEY_PTR(name), &idx)) return NULL;
+	return &r->vars[(size_t)idx - 1];
+}
+
+static enum syntax_binding resolver_bind(struct resolver *r, struct resolve_var *v, int *slot) {
+	if(!v || v->func == RESOLVE_GLOBAL) {
+		*slot = -1;
+		return BIND_GLOBAL;
+	}
+	*slot = v->slot;
+	return v->func == r->depth ? BIND_LOCAL : BIND_UPVALUE;
+}
+
+static struct syntax_block *resolver_block(struct resolver *r) {
+	return r->nscopes ? r->scopes[r->nscopes-1].block : NULL;
+}
+
+static void resolver_symbol(struct resolver *r, const char *prefix, const char *name, size_t l, struct syntax_node *n) {
+	struct syntax_block *b = resolver_block(r);
+	if(!b) return;
+	char *key = strpool_intern_prefix(&r->t->strings, prefix, name, l);
+	struct symbol *s = symbol_create(key, n);
+	if(!symbol_table_insert(syntax_block_symbol_table(r->t, b), s)) symbol_release(s);
+}
+
+/* declare each name of a comma separated list, "..." is skipped. returns
+   the list as written out, which has the aliases under --minify */
+static char *resolver_names(struct resolver *r, char *list, const char *prefix, struct syntax_node *n) {
+	if(!list) return NULL;
+	size_t cap = strlen(list) + 1;
+	for(const char *c = list; *c; c++) {
+		if(*c == ',') cap += 16;
+	}
+	cap += 16;
+	char tmp[256];
+	char *buf = cap <= sizeof(tmp) ? tmp : malloc(cap);
+	size_t len = 0;
+	int renamed = 0;
+
+	const char *p = list;
+	while(*p != '\0') {
+		const char *e = p;
+		while(*e != ',' && *e != '\0') e++;
+		const char *name = p;
+		size_t l = e - p;
+		if(*p != '.') {
+			struct resolve_var *v = resolver_local(r, strpool_intern(&r->t->strings, p, l));
+			if(prefix) resolver_symbol(r, prefix, p, l, n);
+			if(v->alias != v->name) {
+				name = v->alias;
+				l = strpool_len(v->alias);
+				renamed = 1;
+			}
+		}
+		memcpy(buf + len, name, l);
+		len += l;
+		if(*e) buf[len++] = ',';
+		p = *e ? e + 1 : e;
+	}
+
+	char *d = renamed ? strpool_intern(&r->t->strings, buf, len) : list;
+	if(buf != tmp) free(buf);
+	return d;
+}
+
+static void resolve_block(struct resolver *r, struct syntax_block *b) {
+	if(r->nscopes == r->scopes_cap) {
+		r->scopes_cap *= 2;
+		r->scopes = realloc(r->scopes, r->scopes_cap * sizeof(struct resolve_scope));
+	}
+	struct resolve_scope *s = &r->scopes[r->nscopes++];
+	s->block = b;
+	s->base = r->nvars;
+	s->slots = r->slots;
+
+	//parameters and loop variables are only visible in the body
+	struct syntax_node *p = b->n.parent;
+	if(p && p->type == STX_FUNCTION) {
+		struct syntax_function *func = (struct syntax_function *)p;
+		//self goes first in the list of a method
+		if(func->name && strchr(func->name, ':')) {
+			func->pars = func->pars ? syntax_tree_strjoin(r->t, "self", ",", func->pars)
+				: syntax_tree_strdup(r->t, "self");
+		}
+		func->pars = resolver_names(r, func->pars, NULL, NULL);
+	} else if(p && p->type == STX_STATEMENT) {
+		struct syntax_statement *stmt = (struct syntax_statement *)p;
+		if(stmt->tag == STMT_FOR_IN || stmt->tag == STMT_FOR_IT) {
+			stmt->value.name = resolver_names(r, stmt->value.name, NULL, NULL);
+		}
+	}
+}
+
+/* a name of a local function that is not the callee of a call lets it escape */
+static void resolver_use(struct syntax_function *func, struct syntax_node *var) {
+	struct syntax_node *e = var->parent;
+	struct syntax_node *c = e->parent;
+	if(c->type == STX_FUNCTIONCALL && c->children == e && !((struct syntax_functioncall *)c)->name) {
+		((struct syntax_functioncall *)c)->callee = func;
+	} else {
+		func->direct = 0;
+	}
+}
+
+/*
+ * runtime library functions which give one value, called by their global
+ * name they need no fox.first. the globals are trusted not to be replaced.
+ */
+static const char *const lib_single[] = {
+	"print", "type", "tostring", "tonumber", "rawget", "rawset", "rawlen", "rawequal",
+	"setmetatable", "getmetatable",
+	"string.len", "string.sub", "string.upper", "string.lower", "string.rep",
+	"string.reverse", "string.char", "string.format",
+	"math.abs", "math.ceil", "math.floor", "math.sqrt", "math.sin", "math.cos",
+	"math.tan", "math.asin", "math.acos", "math.atan", "math.exp", "math.log",
+	"math.pow", "math.fmod", "math.max", "math.min", "math.random",
+	"math.tointeger", "math.type",
+	"table.insert", "table.remove", "table.concat", "table.sort", "table.pack",
+	NULL
+};
+
+/* the name of a global variable expression, NULL for anything else */
+static const char *exp_global(struct syntax_node *n) {
+	struct syntax_expression *exp = (struct syntax_expression *)n;
+	if(n->type != STX_EXPRESSION || exp->tag != EXP_VAR) return NULL;
+	struct syntax_variable *var = (struct syntax_variable *)n->children;
+	return var->tag == VAR_NORMAL && var->bind == BIND_GLOBAL ? var->name : NULL;
+}
+
+int call_lib_single(struct syntax_functioncall *fcall) {
+	if(fcall->name) return 0;
+	struct syntax_node *f = fcall->n.children;
+	const char *lib = NULL;
+	const char *name = exp_global(f);
+	if(!name) {
+		struct syntax_expression *exp = (struct syntax_expression *)f;
+		if(f->type != STX_EXPRESSION || exp->tag != EXP_VAR) return 0;
+		struct syntax_variable *var = (struct syntax_variable *)f->children;
+		if(var->tag != VAR_KEY || !(lib = exp_global(var->n.children))) return 0;
+		name = var->name;
+	}
+	size_t ll = lib ? strlen(lib) : 0;
+	for(const char *const *w = lib_single; *w; w++) {
+		const char *s = *w;
+		if(lib && (strncmp(s, lib, ll) || s[ll] != '.')) continue;
+		if(lib) s += ll + 1;
+		else if(strchr(s, '.')) continue;
+		if(!strcmp(s, name)) return 1;
+	}
+	return 0;
+}
+
+/* values a return gives, a lone call of a local function gives all of its own */
+static void resolve_return(struct syntax_statement *stmt) {
+	struct syntax_node *p = stmt->n.parent;
+	while(p && p->type != STX_FUNCTION) p = p->parent;
+	if(!p) return;
+
+	struct syntax_function *func = (struct syntax_function *)p;
+	int nrets = stmt->n.count;
+	struct syntax_expression *e = (struct syntax_expression *)stmt->n.children;
+	if(nrets == 1 && e->tag == EXP_FCALL) {
+		struct syntax_functioncall *fcall = (struct syntax_functioncall *)e->n.children;
+		struct syntax_function *callee = fcall->callee;
+		if(callee && callee->nrets > nrets) nrets = callee->nrets;
+		//one value or an array, the callers cannot tell which
+		if(callee ? callee->spread : !call_lib_single(fcall)) func->spread = 1;
+	}
+	//as many values as ... has, only an array holds them
+	while(e->n.next) e = (struct syntax_expression *)e->n.next;
+	if(e->tag == EXP_DOTS) {
+		func->spread = 1;
+		if(nrets < 2) nrets = 2;
+	}
+	if(nrets > func->nrets) func->nrets = nrets;
+}
+
+static void resolve_variable(struct resolver *r, struct syntax_variable *var) {
+	if(var->tag != VAR_NORMAL) return;
+	struct resolve_var *v = resolver_find(r, var->name);
+	var->bind = resolver_bind(r, v, &var->slot);
+	if(var->bind != BIND_GLOBAL) {
+		var->name = v->alias;
+		if(v->lfunc) resolver_use(v->lfunc, &var->n);
+		return;
+	}
+
+	//first assignment of a global in this scope
+	struct syntax_node *p = var->n.parent;
+	if(p->type != STX_STATEMENT || ((struct syntax_statement *)p)->tag != STMT_VAR) return;
+	if(!v || chunk_scope(p)) {
+		resolver_symbol(r, "v_", var->name, strpool_len(var->name), &var->n);
+	}
+	if(!v) resolver_push(r, var->name, RESOLVE_GLOBAL, -1);
+}
+
+static void resolve_statement(struct resolver *r, struct syntax_statement *stmt) {
+	struct syntax_function *func = (struct syntax_function *)stmt->n.children;
+	if(stmt->tag != STMT_FUNC && stmt->tag != STMT_LOCAL_FUNC) return;
+	if(!func->name) return;
+	size_t dot = strcspn(func->name, ".:");
+	if(func->name[dot] != '\0') {
+		//a field of a table, which may be a renamed local
+		const char *base = strpool_find(&r->t->strings, func->name, dot);
+		struct resolve_var *v = base ? resolver_find(r, base) : NULL;
+		if(v && v->alias != v->name) func->name = syntax_tree_strjoin(r->t, v->alias, "", func->name + dot);
+		return;
+	}
+
+	size_t l = strpool_len(func->name);
+	if(stmt->tag == STMT_LOCAL_FUNC) {
+		//visible in its own body for recursion
+		resolver_symbol(r, "lf_", func->name, l, &func->n);
+		struct resolve_var *v = resolver_local(r, func->name);
+		func->slot = v->slot;
+		func->bind = BIND_LOCAL;
+		func->name = v->alias;
+		func->direct = 1;
+		v->lfunc = func;
+	} else {
+		resolver_symbol(r, "f_", func->name, l, &func->n);
+		struct resolve_var *v = resolver_find(r, func->name);
+		func->bind = resolver_bind(r, v, &func->slot);
+		if(func->bind != BIND_GLOBAL) {
+			func->name = v->alias;
+			//the calls so far went to the old body
+			if(v->lfunc) v->lfunc->direct = 0;
+		}
+	}
+}
+
+static void resolve_enter(struct resolver *r, struct syntax_node *n) {
+	switch(n->type) {
+	case STX_BLOCK:
+		resolve_block(r, (struct syntax_block *)n);
+		break;
+	case STX_STATEMENT:
+		resolve_statement(r, (struct syntax_statement *)n);
+		break;
+	case STX_VARIABLE:
+		resolve_variable(r, (struct syntax_variable *)n);
+		break;
+	case STX_FUNCTION:
+		if(r->depth == r->saved_cap) {
+			r->saved_cap *= 2;
+			r->saved = realloc(r->saved, r->saved_cap * sizeof(int));
+		}
+		r->saved[r->depth++] = r->slots;
+		r->slots = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+static void resolve_leave(struct resolver *r, struct syntax_node *n) {
+	switch(n->type) {
+	case STX_BLOCK:
+	{
+		struct resolve_scope *s = &r->scopes[--r->nscopes];
+		resolver_pop(r, s->base);
+		r->slots = s->slots;
+		break;
+	}
+	case STX_STATEMENT:
+	{
+		//locals come into scope after their initializers
+		struct syntax_statement *stmt = (struct syntax_statement *)n;
+		if(stmt->tag == STMT_LOCAL_VAR) {
+			stmt->value.name = resolver_names(r, stmt->value.name, "lv_", n);
+			//local f = function, a local function that cannot call itself
+			struct syntax_expression *e = (struct syntax_expression *)n->children;
+			if(n->count == 1 && e->tag == EXP_FUNC && !strchr(stmt->value.name, ',')) {
+				struct syntax_function *func = (struct syntax_function *)e->n.children;
+				func->direct = 1;
+				r->vars[r->nvars-1].lfunc = func;
+			}
+		} else if(stmt->tag == STMT_RETURN && n->children) {
+			resolve_return(stmt);
+		}
+		break;
+	}
+	case STX_FUNCTION:
+		r->slots = r->saved[--r->depth];
+		break;
+	default:
+		break;
+	}
+}
+
+void gen_chunk_symtables(struct syntax_tree *t, struct syntax_chunk *chunk) {
+	struct resolver r;
+	resolver_init(&r, t);
+	struct syntax_node *root = &chunk->n;
+	struct syntax_node *n = root;
+	resolve_enter(&r, n);
+	while(n) {
+		if(n->children) {
+			n = n->children;
+			resolve_enter(&r, n);
+			continue;
+		}
+		resolve_leave(&r, n);
+		while(n != root && !n->next) {
+			n = n->parent;
+			resolve_leave(&r, n);
+		}
+		if(n == root) break;
+		n = n->next;
+		resolve_enter(&r, n);
+	}
+	resolver_release(&r);
+}
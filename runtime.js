@@ -0,0 +1,1313 @@
+// fox_runtime.js @FOX_VERSION@, lua semantics for the js fox generates.
+// built from runtime.js, every translated module requires it once as fox.
+"use strict";
+
+const VERSION = "@FOX_VERSION@";
+const nil = undefined;
+
+class LuaError extends Error {
+	constructor(value) {
+		super(typeof value === "string" ? value : "(error object is a " + type(value) + " value)");
+		this.value = value;
+	}
+}
+
+function error(msg) {
+	throw new LuaError(msg);
+}
+
+/*
+ * a lua table. keys 1..arr.length live in arr, nil holes included, the
+ * last one never nil. any other key lives in hash. all tables have the
+ * same shape and so do all hash parts, the helpers below only ever see
+ * one kind of object and stay monomorphic.
+ */
+class Table {
+	constructor(arr) {
+		this.arr = arr;
+		this.hash = null;	// made on the first key outside arr
+		this.meta = null;
+	}
+}
+
+/*
+ * keys in insertion order with their values beside them, idx maps a key
+ * to its slot. a key set to nil keeps its slot so a traversal can go on
+ * past it, dead slots are dropped once they are half of them. a key is
+ * only added outside a traversal, so that is when they are dropped.
+ * the key arr.length + 1 is never here, it would go to arr.
+ */
+class Hash {
+	constructor() {
+		this.keys = [];
+		this.vals = [];
+		this.idx = new Map();
+		this.dead = 0;
+	}
+}
+
+function table(arr, kv) {
+	const t = new Table(arr === undefined ? [] : arr);
+	trim(t.arr);
+	if(kv !== undefined) {
+		for(let i = 0; i < kv.length; i += 2) rawset(t, kv[i], kv[i + 1]);
+	}
+	return t;
+}
+
+/* tables of a JSON.parse, arrays turn into the array part */
+function data(v) {
+	if(typeof v !== "object" || v === null) return v;
+	if(Array.isArray(v)) {
+		for(let i = 0; i < v.length; i++) v[i] = data(v[i]);
+		return new Table(v);
+	}
+	const t = new Table([]);
+	for(const k of Object.keys(v)) hashset(t, k, data(v[k]));
+	return t;
+}
+
+function trim(a) {
+	let n = a.length;
+	if(n === 0 || a[n - 1] !== undefined) return;
+	while(n > 0 && a[n - 1] === undefined) n--;
+	a.length = n;
+}
+
+function istable(t) {
+	return t instanceof Table;
+}
+
+function rawget(t, k) {
+	if(typeof k === "number") {
+		const a = t.arr;
+		if((k | 0) === k && k > 0 && k <= a.length) return a[k - 1];
+	}
+	const h = t.hash;
+	if(h === null) return undefined;
+	const s = h.idx.get(k);
+	return s === undefined ? undefined : h.vals[s];
+}
+
+function rawset(t, k, v) {
+	if(typeof k === "number") {
+		const a = t.arr;
+		const n = a.length;
+		if((k | 0) === k && k > 0 && k <= n + 1) {
+			if(k <= n) {
+				a[k - 1] = v;
+				if(k === n && v === undefined) trim(a);
+			} else if(v !== undefined) {
+				a.push(v);
+				if(t.hash !== null) migrate(t);
+			}
+			return t;
+		}
+		if(k !== k) error("table index is NaN");
+	} else if(k === undefined) {
+		error("table index is nil");
+	}
+	hashset(t, k, v);
+	return t;
+}
+
+function hashset(t, k, v) {
+	let h = t.hash;
+	if(h === null) {
+		if(v === undefined) return;
+		h = t.hash = new Hash();
+	}
+	const s = h.idx.get(k);
+	if(s !== undefined) {
+		const old = h.vals[s];
+		h.vals[s] = v;
+		if(old === undefined) h.dead--;
+		if(v === undefined) h.dead++;
+		return;
+	}
+	if(v === undefined) return;
+	if(h.dead > 8 && h.dead * 2 > h.keys.length) compact(h);
+	h.idx.set(k, h.keys.length);
+	h.keys.push(k);
+	h.vals.push(v);
+}
+
+function compact(h) {
+	const keys = h.keys, vals = h.vals;
+	let j = 0;
+	h.idx.clear();
+	for(let i = 0; i < keys.length; i++) {
+		if(vals[i] === undefined) continue;
+		keys[j] = keys[i];
+		vals[j] = vals[i];
+		h.idx.set(keys[i], j++);
+	}
+	keys.length = j;
+	vals.length = j;
+	h.dead = 0;
+}
+
+/* the array part grew, keys after it move over from the hash part */
+function migrate(t) {
+	const a = t.arr, h = t.hash;
+	let s;
+	while((s = h.idx.get(a.length + 1)) !== undefined) {
+		const v = h.vals[s];
+		h.idx.delete(a.length + 1);
+		h.vals[s] = undefined;
+		h.dead++;
+		if(v === undefined) break;
+		a.push(v);
+	}
+}
+
+/* arr.length is a border, its last value is set and the next key is not */
+function rawlen(t) {
+	return typeof t === "string" ? t.length : t.arr.length;
+}
+
+function rawequal(a, b) {
+	return a === b;
+}
+
+function metaof(v) {
+	if(v instanceof Table) return v.meta;
+	if(typeof v === "string") return stringmeta;
+	return null;
+}
+
+function metafield(v, name) {
+	const m = metaof(v);
+	return m === null ? undefined : rawget(m, name);
+}
+
+/* the first of the values a call gives */
+function first(v) {
+	return Array.isArray(v) ? v[0] : v;
+}
+
+/* the values of the last take, null when it was a bare one */
+let taken = null;
+
+/* the first of the values a call gives, the others are kept for rest */
+function take(v) {
+	if(Array.isArray(v)) {
+		taken = v;
+		return v[0];
+	}
+	taken = null;
+	return v;
+}
+
+function rest(i) {
+	return taken === null ? undefined : taken[i];
+}
+
+/* all of them, for the last argument or array item */
+function values(v) {
+	return Array.isArray(v) ? v : [v];
+}
+
+function index(t, k) {
+	if(t instanceof Table) {
+		const v = rawget(t, k);
+		if(v !== undefined || t.meta === null) return v;
+	}
+	return indexmeta(t, k);
+}
+
+function indexmeta(t, k) {
+	for(let loop = 0; loop < 100; loop++) {
+		let h;
+		if(t instanceof Table) {
+			const v = rawget(t, k);
+			if(v !== undefined || t.meta === null) return v;
+			h = rawget(t.meta, "__index");
+			if(h === undefined) return undefined;
+		} else if(typeof t === "string") {
+			h = rawget(stringmeta, "__index");
+		} else if(t === undefined || t === null || typeof t === "boolean" || typeof t === "number") {
+			error("attempt to index a " + type(t) + " value" + (k === undefined ? "" : " (field '" + tostring(k) + "')"));
+		} else {
+			//a js object handed in by the host
+			return t[k];
+		}
+		if(typeof h === "function") return first(h(t, k));
+		t = h;
+	}
+	error("'__index' chain too long; possible loop");
+}
+
+function setindex(t, k, v) {
+	if(t instanceof Table && (t.meta === null || rawget(t, k) !== undefined)) {
+		rawset(t, k, v);
+		return;
+	}
+	setindexmeta(t, k, v);
+}
+
+function setindexmeta(t, k, v) {
+	for(let loop = 0; loop < 100; loop++) {
+		if(t instanceof Table) {
+			const h = t.meta === null || rawget(t, k) !== undefined ? undefined : rawget(t.meta, "__newindex");
+			if(h === undefined) {
+				rawset(t, k, v);
+				return;
+			}
+			if(typeof h === "function") {
+				h(t, k, v);
+				return;
+			}
+			t = h;
+		} else if(t !== null && (typeof t === "object" || typeof t === "function")) {
+			t[k] = v;
+			return;
+		} else {
+			error("attempt to index a " + type(t) + " value" + (k === undefined ? "" : " (field '" + tostring(k) + "')"));
+		}
+	}
+	error("'__newindex' chain too long; possible loop");
+}
+
+/* o:name(...), for an o which is not a plain name */
+function invoke(o, name, ...args) {
+	return call(index(o, name), o, ...args);
+}
+
+function call(f, ...args) {
+	if(typeof f === "function") return f(...args);
+	const h = metafield(f, "__call");
+	if(h === undefined) error("attempt to call a " + type(f) + " value");
+	return h(f, ...args);
+}
+
+function len(v) {
+	if(typeof v === "string") return v.length;
+	if(v instanceof Table && v.meta === null) return v.arr.length;
+	return lenmeta(v);
+}
+
+function lenmeta(v) {
+	const h = metafield(v, "__len");
+	if(h !== undefined) return first(h(v));
+	if(v instanceof Table) return v.arr.length;
+	error("attempt to get length of a " + type(v) + " value");
+}
+
+function concat(a, b) {
+	if(typeof a === "string" && typeof b === "string") return a + b;
+	if((typeof a === "string" || typeof a === "number") && (typeof b === "string" || typeof b === "number")) {
+		return (typeof a === "number" ? numstr(a) : a) + (typeof b === "number" ? numstr(b) : b);
+	}
+	const h = metafield(a, "__concat") || metafield(b, "__concat");
+	if(h === undefined) {
+		error("attempt to concatenate a " + type(typeof a === "string" || typeof a === "number" ? b : a) + " value");
+	}
+	return first(h(a, b));
+}
+
+/* the cursor after c holding a value, -1 when there is none. -1 also
+   starts a traversal. array slots count up from 0, hash slots down from
+   -2, clearing a key while traversing moves no cursor */
+function step(t, c) {
+	let s = 0;
+	if(c >= -1) {
+		const a = t.arr;
+		for(let i = c + 1; i < a.length; i++) {
+			if(a[i] !== undefined) return i;
+		}
+	} else {
+		s = -1 - c;
+	}
+	const h = t.hash;
+	if(h !== null) {
+		const vals = h.vals;
+		for(; s < vals.length; s++) {
+			if(vals[s] !== undefined) return -2 - s;
+		}
+	}
+	return -1;
+}
+
+function key(t, c) {
+	return c >= 0 ? c + 1 : t.hash.keys[-2 - c];
+}
+
+function value(t, c) {
+	return c >= 0 ? t.arr[c] : t.hash.vals[-2 - c];
+}
+
+/* the table a pairs loop walks */
+function walk(t) {
+	if(t instanceof Table) return t;
+	error("bad argument #1 to 'for iterator' (table expected, got " + type(t) + ")");
+}
+
+/* a pairs loop over a table with __pairs, the iterator it gave */
+class Pairs {
+	constructor(r) {
+		this.f = r[0];
+		this.s = r[1];
+		this.c = r[2];
+		this.k = undefined;
+		this.v = undefined;
+	}
+}
+
+/* the loop's iterator of t, null for a plain walk */
+function custom(t) {
+	if(t.meta === null) return null;
+	const h = metafield(t, "__pairs");
+	return h === undefined ? null : new Pairs(values(h(t)));
+}
+
+/* one call of a __pairs iterator, its key and value are left in p */
+function pstep(p) {
+	const r = p.f(p.s, p.c);
+	const k = first(r);
+	if(k === undefined) return -1;
+	p.c = p.k = k;
+	p.v = Array.isArray(r) ? r[1] : undefined;
+	return 0;
+}
+
+function cursor(t, k) {
+	if(k === undefined) return -1;
+	if(typeof k === "number" && (k | 0) === k && k > 0 && k <= t.arr.length) return k - 1;
+	const s = t.hash === null ? undefined : t.hash.idx.get(k);
+	if(s === undefined) error("invalid key to 'next'");
+	return -2 - s;
+}
+
+function next(t, k) {
+	const c = step(walk(t), cursor(t, k));
+	return c === -1 ? [undefined] : [key(t, c), value(t, c)];
+}
+
+function pairs(t) {
+	const h = metafield(t, "__pairs");
+	if(h !== undefined) return h(t);
+	return [next, walk(t), undefined];
+}
+
+function inext(t, i) {
+	const v = index(t, ++i);
+	return v === undefined ? [undefined] : [i, v];
+}
+
+function ipairs(t) {
+	if(t === undefined) error("bad argument #1 to 'ipairs' (table expected, got nil)");
+	return [inext, t, 0];
+}
+
+function type(v) {
+	switch(typeof v) {
+	case "undefined": return "nil";
+	case "boolean": return "boolean";
+	case "number": return "number";
+	case "string": return "string";
+	case "function": return "function";
+	default: return v === null ? "nil" : v instanceof Table ? "table" : "userdata";
+	}
+}
+
+function numstr(n) {
+	if(Number.isInteger(n) && Math.abs(n) < 1e16) return String(n);
+	if(n !== n) return "nan";
+	if(n === Infinity) return "inf";
+	if(n === -Infinity) return "-inf";
+	return fmtg(n, 14, false);
+}
+
+function tostring(v) {
+	switch(typeof v) {
+	case "string": return v;
+	case "number": return numstr(v);
+	case "undefined": return "nil";
+	case "boolean": return v ? "true" : "false";
+	default:
+		break;
+	}
+	const h = metafield(v, "__tostring");
+	if(h !== undefined) return first(h(v));
+	if(v instanceof Table) return "table: 0x" + address(v);
+	if(typeof v === "function") return "function: 0x" + address(v);
+	return String(v);
+}
+
+const addresses = new WeakMap();
+let naddress = 0;
+
+function address(v) {
+	let a = addresses.get(v);
+	if(a === undefined) {
+		a = (0x55550000 + 32 * ++naddress).toString(16).padStart(14, "0");
+		addresses.set(v, a);
+	}
+	return a;
+}
+
+function tonumber(v, base) {
+	if(base === undefined) {
+		if(typeof v === "number") return v;
+		if(typeof v !== "string") return undefined;
+		const s = v.trim();
+		if(/^[-+]?0[xX][0-9a-fA-F]+$/.test(s)) return s[0] === "-" ? -parseInt(s.slice(1), 16) : parseInt(s, 16);
+		if(!/^[-+]?(\d+\.?\d*|\.\d+)([eE][-+]?\d+)?$/.test(s)) return undefined;
+		return Number(s);
+	}
+	const s = tostring(v).trim().toLowerCase();
+	const digits = "0123456789abcdefghijklmnopqrstuvwxyz".slice(0, base);
+	let i = 0, neg = false, n = 0;
+	if(s[0] === "-") {
+		neg = true;
+		i++;
+	}
+	if(i === s.length) return undefined;
+	for(; i < s.length; i++) {
+		const d = digits.indexOf(s[i]);
+		if(d < 0) return undefined;
+		n = n * base + d;
+	}
+	return neg ? -n : n;
+}
+
+function select(n, ...args) {
+	if(n === "#") return args.length;
+	if(n < 0) n = args.length + n;
+	else if(n === 0) error("bad argument #1 to 'select' (index out of range)");
+	else n--;
+	return args.slice(n);
+}
+
+function setmetatable(t, m) {
+	if(!(t instanceof Table)) error("bad argument #1 to 'setmetatable' (table expected, got " + type(t) + ")");
+	if(t.meta !== null && rawget(t.meta, "__metatable") !== undefined) error("cannot change a protected metatable");
+	t.meta = m === undefined ? null : m;
+	return t;
+}
+
+function getmetatable(v) {
+	const m = metaof(v);
+	if(m === null) return undefined;
+	const p = rawget(m, "__metatable");
+	return p !== undefined ? p : m;
+}
+
+function assert(v, msg, ...rest) {
+	if(v === undefined || v === false) error(msg === undefined ? "assertion failed!" : msg);
+	return msg === undefined ? v : [v, msg, ...rest];
+}
+
+function pcall(f, ...args) {
+	try {
+		const r = call(f, ...args);
+		return Array.isArray(r) ? [true, ...r] : [true, r];
+	} catch(e) {
+		return [false, e instanceof LuaError ? e.value : String(e && e.message !== undefined ? e.message : e)];
+	}
+}
+
+function xpcall(f, handler, ...args) {
+	try {
+		const r = call(f, ...args);
+		return Array.isArray(r) ? [true, ...r] : [true, r];
+	} catch(e) {
+		return [false, first(handler(e instanceof LuaError ? e.value : String(e && e.message !== undefined ? e.message : e)))];
+	}
+}
+
+function print(...args) {
+	console.log(args.map(tostring).join("\t"));
+}
+
+function unpack(t, i, j) {
+	i = i === undefined ? 1 : i;
+	j = j === undefined ? len(t) : j;
+	const r = [];
+	for(; i <= j; i++) r.push(index(t, i));
+	return r;
+}
+
+function lib(fields) {
+	const t = new Table([]);
+	for(const k of Object.keys(fields)) hashset(t, k, fields[k]);
+	return t;
+}
+
+/* table library */
+
+function tinsert(t, pos, v) {
+	const n = len(t);
+	if(v === undefined && arguments.length < 3) {
+		setindex(t, n + 1, pos);
+		return;
+	}
+	if(pos < 1 || pos > n + 1) error("bad argument #2 to 'insert' (position out of bounds)");
+	if(t.meta === null && n === t.arr.length && v !== undefined) {
+		t.arr.splice(pos - 1, 0, v);
+		trim(t.arr);
+		if(t.hash !== null) migrate(t);
+		return;
+	}
+	for(let i = n; i >= pos; i--) setindex(t, i + 1, index(t, i));
+	setindex(t, pos, v);
+}
+
+function tremove(t, pos) {
+	const n = len(t);
+	if(pos === undefined) pos = n;
+	else if(pos !== n && (pos < 1 || pos > n + 1)) error("bad argument #2 to 'remove' (position out of bounds)");
+	const v = index(t, pos);
+	if(t.meta === null && pos >= 1 && pos <= n && n === t.arr.length) {
+		t.arr.splice(pos - 1, 1);
+		trim(t.arr);
+		return v;
+	}
+	for(; pos < n; pos++) setindex(t, pos, index(t, pos + 1));
+	setindex(t, pos, undefined);
+	return v;
+}
+
+function tconcat(t, sep, i, j) {
+	sep = sep === undefined ? "" : sep;
+	i = i === undefined ? 1 : i;
+	j = j === undefined ? len(t) : j;
+	const parts = [];
+	for(; i <= j; i++) {
+		const v = index(t, i);
+		if(typeof v === "string") parts.push(v);
+		else if(typeof v === "number") parts.push(numstr(v));
+		else error("invalid value (at index " + i + ") in table for 'concat'");
+	}
+	return parts.join(sep);
+}
+
+function tsort(t, comp) {
+	const n = len(t);
+	const a = [];
+	for(let i = 1; i <= n; i++) a.push(index(t, i));
+	const less = comp === undefined ? lt : (x, y) => {
+		const r = first(comp(x, y));
+		return r !== undefined && r !== false;
+	};
+	a.sort((x, y) => less(x, y) ? -1 : less(y, x) ? 1 : 0);
+	for(let i = 1; i <= n; i++) setindex(t, i, a[i - 1]);
+}
+
+function lt(a, b) {
+	if(typeof a === "number" && typeof b === "number") return a < b;
+	if(typeof a === "string" && typeof b === "string") return a < b;
+	const h = metafield(a, "__lt") || metafield(b, "__lt");
+	if(h === undefined) error("attempt to compare two " + type(a) + " values");
+	const r = first(h(a, b));
+	return r !== undefined && r !== false;
+}
+
+function tpack(...args) {
+	const t = table(args);
+	rawset(t, "n", args.length);
+	return t;
+}
+
+/* string library, lua patterns work on the utf-16 units of a js string */
+
+function strindex(i, l) {
+	return i >= 0 ? i : i + l + 1 < 0 ? 0 : i + l + 1;
+}
+
+function sub(s, i, j) {
+	s = tostr(s);
+	const l = s.length;
+	i = strindex(i === undefined ? 1 : i, l);
+	j = strindex(j === undefined ? -1 : j, l);
+	if(i < 1) i = 1;
+	if(j > l) j = l;
+	return i > j ? "" : s.slice(i - 1, j);
+}
+
+function tostr(s) {
+	if(typeof s === "string") return s;
+	if(typeof s === "number") return numstr(s);
+	error("bad argument #1 (string expected, got " + type(s) + ")");
+}
+
+function byte(s, i, j) {
+	s = tostr(s);
+	i = strindex(i === undefined ? 1 : i, s.length);
+	j = j === undefined ? i : strindex(j, s.length);
+	if(i < 1) i = 1;
+	if(j > s.length) j = s.length;
+	if(i > j) return undefined;
+	if(i === j) return s.charCodeAt(i - 1);
+	const r = [];
+	for(; i <= j; i++) r.push(s.charCodeAt(i - 1));
+	return r;
+}
+
+function char(...codes) {
+	return String.fromCharCode(...codes);
+}
+
+function rep(s, n, sep) {
+	s = tostr(s);
+	if(n <= 0) return "";
+	if(sep === undefined || sep === "") return s.repeat(n);
+	return (s + sep).repeat(n - 1) + s;
+}
+
+/* %.<p>g of c printf */
+function fmtg(n, p, alt) {
+	if(p === 0) p = 1;
+	if(n === 0) return (1 / n < 0 ? "-0" : "0") + (alt && p > 1 ? "." + "0".repeat(p - 1) : "");
+	const s = n.toExponential(p - 1);
+	const i = s.indexOf("e");
+	const exp = Number(s.slice(i + 1));
+	let m = exp < -4 || exp >= p ? s.slice(0, i) : n.toFixed(p - 1 - exp);
+	if(!alt && m.indexOf(".") >= 0) m = m.replace(/\.?0+$/, "");
+	if(exp < -4 || exp >= p) m += "e" + (exp < 0 ? "-" : "+") + String(Math.abs(exp)).padStart(2, "0");
+	return m;
+}
+
+function fmtexp(n, p, upper) {
+	let s = n.toExponential(p);
+	const i = s.indexOf("e");
+	const exp = Number(s.slice(i + 1));
+	s = s.slice(0, i) + "e" + (exp < 0 ? "-" : "+") + String(Math.abs(exp)).padStart(2, "0");
+	return upper ? s.toUpperCase() : s;
+}
+
+function pad(s, width, left, zero) {
+	if(width === undefined || s.length >= width) return s;
+	if(left) return s + " ".repeat(width - s.length);
+	if(zero) {
+		const sign = s[0] === "-" || s[0] === "+" || s[0] === " " ? s[0] : "";
+		return sign + "0".repeat(width - s.length) + s.slice(sign.length);
+	}
+	return " ".repeat(width - s.length) + s;
+}
+
+function quote(s) {
+	let r = "\"";
+	for(let i = 0; i < s.length; i++) {
+		const c = s.charCodeAt(i);
+		if(c === 34 || c === 92) r += "\\" + s[i];
+		else if(c === 10) r += "\\\n";
+		else if(c === 13) r += "\\r";
+		else if(c < 32 || c === 127) r += "\\" + (/\d/.test(s[i + 1] || "") ? String(c).padStart(3, "0") : c);
+		else r += s[i];
+	}
+	return r + "\"";
+}
+
+function format(fmt, ...args) {
+	fmt = tostr(fmt);
+	let out = "";
+	let arg = 0;
+	for(let i = 0; i < fmt.length; i++) {
+		const c = fmt[i];
+		if(c !== "%") {
+			out += c;
+			continue;
+		}
+		if(fmt[++i] === "%") {
+			out += "%";
+			continue;
+		}
+		let flags = "";
+		while("-+ #0".indexOf(fmt[i]) >= 0) flags += fmt[i++];
+		let width, prec;
+		let d = "";
+		while(fmt[i] >= "0" && fmt[i] <= "9") d += fmt[i++];
+		if(d) width = Number(d);
+		if(fmt[i] === ".") {
+			d = "";
+			i++;
+			while(fmt[i] >= "0" && fmt[i] <= "9") d += fmt[i++];
+			prec = Number(d || "0");
+		}
+		const conv = fmt[i];
+		if(conv === undefined) error("invalid conversion '%" + flags + "' to 'format'");
+		if(++arg > args.length && conv !== "%") error("bad argument #" + (arg + 1) + " to 'format' (no value)");
+		const v = args[arg - 1];
+		const left = flags.indexOf("-") >= 0;
+		const zero = flags.indexOf("0") >= 0 && !left;
+		const sign = flags.indexOf("+") >= 0 ? "+" : flags.indexOf(" ") >= 0 ? " " : "";
+		let s;
+		switch(conv) {
+		case "d":
+		case "i":
+		{
+			const n = tonumber(v);
+			if(n === undefined || !Number.isInteger(n)) error("bad argument #" + (arg + 1) + " to 'format' (number has no integer representation)");
+			s = String(Math.abs(n));
+			if(prec !== undefined) s = s.padStart(prec, "0");
+			s = (n < 0 ? "-" : sign) + s;
+			out += pad(s, width, left, zero && prec === undefined);
+			continue;
+		}
+		case "u":
+			s = String(Math.abs(Math.trunc(tonumber(v))));
+			out += pad(s, width, left, zero);
+			continue;
+		case "c":
+			out += pad(String.fromCharCode(v), width, left, false);
+			continue;
+		case "x":
+		case "X":
+		case "o":
+		{
+			let n = Math.trunc(tonumber(v));
+			if(n < 0) n = BigInt.asUintN(64, BigInt(n));
+			s = n.toString(conv === "o" ? 8 : 16);
+			if(conv === "X") s = s.toUpperCase();
+			if(prec !== undefined) s = s.padStart(prec, "0");
+			if(flags.indexOf("#") >= 0 && n != 0) s = (conv === "o" ? "0" : conv === "x" ? "0x" : "0X") + s;
+			out += pad(s, width, left, zero);
+			continue;
+		}
+		case "e":
+		case "E":
+		case "f":
+		case "F":
+		case "g":
+		case "G":
+		{
+			const n = tonumber(v);
+			if(n === undefined) error("bad argument #" + (arg + 1) + " to 'format' (number expected, got " + type(v) + ")");
+			const p = prec === undefined ? 6 : prec;
+			if(!isFinite(n)) {
+				s = n !== n ? "nan" : "inf";
+				if(conv < "a") s = s.toUpperCase();
+			} else if(conv === "e" || conv === "E") {
+				s = fmtexp(Math.abs(n), p, conv === "E");
+			} else if(conv === "f" || conv === "F") {
+				s = Math.abs(n).toFixed(p);
+			} else {
+				s = fmtg(Math.abs(n), p, flags.indexOf("#") >= 0);
+				if(conv === "G") s = s.toUpperCase();
+			}
+			s = (n < 0 || (n === 0 && 1 / n < 0) ? "-" : sign) + s;
+			out += pad(s, width, left, zero && isFinite(n));
+			continue;
+		}
+		case "a":
+		case "A":
+			s = tonumber(v).toString(16);
+			out += pad(conv === "A" ? s.toUpperCase() : s, width, left, zero);
+			continue;
+		case "q":
+			out += typeof v === "string" ? quote(v) : tostring(v);
+			continue;
+		case "s":
+			s = tostring(v);
+			if(prec !== undefined) s = s.slice(0, prec);
+			out += pad(s, width, left, false);
+			continue;
+		default:
+			error("invalid conversion '%" + flags + (width === undefined ? "" : width) + conv + "' to 'format'");
+		}
+	}
+	return out;
+}
+
+/* lua patterns, after lstrlib.c */
+
+const MAXCAPTURES = 32;
+const CAP_UNFINISHED = -1;
+const CAP_POSITION = -2;
+
+class MatchState {
+	constructor(src, pat) {
+		this.src = src;
+		this.pat = pat;
+		this.level = 0;
+		this.depth = 0;
+		this.start = new Array(MAXCAPTURES).fill(0);
+		this.len = new Array(MAXCAPTURES).fill(0);
+	}
+}
+
+function classend(ms, p) {
+	const pat = ms.pat;
+	if(p >= pat.length) error("malformed pattern (ends with '%')");
+	const c = pat[p++];
+	if(c === "%") {
+		if(p >= pat.length) error("malformed pattern (ends with '%')");
+		return p + 1;
+	}
+	if(c === "[") {
+		if(pat[p] === "^") p++;
+		do {
+			if(p >= pat.length) error("malformed pattern (missing ']')");
+			const cc = pat[p++];
+			if(cc === "%") p++;
+		} while(pat[p] !== "]");
+		return p + 1;
+	}
+	return p;
+}
+
+function classmatch(c, cl) {
+	let r;
+	const lower = cl.toLowerCase();
+	switch(lower) {
+	case "a": r = (c >= 65 && c <= 90) || (c >= 97 && c <= 122); break;
+	case "c": r = c < 32 || c === 127; break;
+	case "d": r = c >= 48 && c <= 57; break;
+	case "g": r = c > 32 && c < 127; break;
+	case "l": r = c >= 97 && c <= 122; break;
+	case "p": r = (c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) || (c >= 123 && c <= 126); break;
+	case "s": r = c === 32 || (c >= 9 && c <= 13); break;
+	case "u": r = c >= 65 && c <= 90; break;
+	case "w": r = (c >= 48 && c <= 57) || (c >= 65 && c <= 90) || (c >= 97 && c <= 122); break;
+	case "x": r = (c >= 48 && c <= 57) || (c >= 65 && c <= 70) || (c >= 97 && c <= 102); break;
+	default: return cl.charCodeAt(0) === c;
+	}
+	return cl === lower ? r : !r;
+}
+
+function matchbracket(ms, c, p, ec) {
+	const pat = ms.pat;
+	let sig = true;
+	if(pat[p + 1] === "^") {
+		sig = false;
+		p++;
+	}
+	while(++p < ec) {
+		if(pat[p] === "%") {
+			p++;
+			if(classmatch(c, pat[p])) return sig;
+		} else if(pat[p + 1] === "-" && p + 2 < ec) {
+			if(pat.charCodeAt(p) <= c && c <= pat.charCodeAt(p + 2)) return sig;
+			p += 2;
+		} else if(pat.charCodeAt(p) === c) {
+			return sig;
+		}
+	}
+	return !sig;
+}
+
+function singlematch(ms, s, p, ep) {
+	if(s >= ms.src.length) return false;
+	const c = ms.src.charCodeAt(s);
+	switch(ms.pat[p]) {
+	case ".": return true;
+	case "%": return classmatch(c, ms.pat[p + 1]);
+	case "[": return matchbracket(ms, c, p, ep - 1);
+	default: return ms.pat.charCodeAt(p) === c;
+	}
+}
+
+function matchbalance(ms, s, p) {
+	if(p + 1 >= ms.pat.length) error("malformed pattern (missing arguments to '%b')");
+	if(s >= ms.src.length || ms.src[s] !== ms.pat[p]) return -1;
+	const b = ms.pat[p], e = ms.pat[p + 1];
+	let cont = 1;
+	while(++s < ms.src.length) {
+		const c = ms.src[s];
+		if(c === e) {
+			if(--cont === 0) return s + 1;
+		} else if(c === b) {
+			cont++;
+		}
+	}
+	return -1;
+}
+
+function maxexpand(ms, s, p, ep) {
+	let i = 0;
+	while(singlematch(ms, s + i, p, ep)) i++;
+	while(i >= 0) {
+		const r = domatch(ms, s + i, ep + 1);
+		if(r !== -1) return r;
+		i--;
+	}
+	return -1;
+}
+
+function minexpand(ms, s, p, ep) {
+	for(;;) {
+		const r = domatch(ms, s, ep + 1);
+		if(r !== -1) return r;
+		if(singlematch(ms, s, p, ep)) s++;
+		else return -1;
+	}
+}
+
+function startcapture(ms, s, p, what) {
+	if(ms.level >= MAXCAPTURES) error("too many captures");
+	ms.start[ms.level] = s;
+	ms.len[ms.level] = what;
+	ms.level++;
+	const r = domatch(ms, s, p);
+	if(r === -1) ms.level--;
+	return r;
+}
+
+function endcapture(ms, s, p) {
+	let l = -1;
+	for(let i = ms.level - 1; i >= 0; i--) {
+		if(ms.len[i] === CAP_UNFINISHED) {
+			l = i;
+			break;
+		}
+	}
+	if(l < 0) error("invalid pattern capture");
+	ms.len[l] = s - ms.start[l];
+	const r = domatch(ms, s, p);
+	if(r === -1) ms.len[l] = CAP_UNFINISHED;
+	return r;
+}
+
+function matchcapture(ms, s, l) {
+	l -= 49;
+	if(l < 0 || l >= ms.level || ms.len[l] === CAP_UNFINISHED) error("invalid capture index %" + (l + 1));
+	const cap = ms.src.substr(ms.start[l], ms.len[l]);
+	if(ms.src.length - s >= cap.length && ms.src.substr(s, cap.length) === cap) return s + cap.length;
+	return -1;
+}
+
+/* end of the match of pat[p..] at s, -1 if there is none */
+function domatch(ms, s, p) {
+	if(ms.depth++ > 200) error("pattern too complex");
+	try {
+		const pat = ms.pat;
+		while(p < pat.length) {
+			switch(pat[p]) {
+			case "(":
+				if(pat[p + 1] === ")") return startcapture(ms, s, p + 2, CAP_POSITION);
+				return startcapture(ms, s, p + 1, CAP_UNFINISHED);
+			case ")":
+				return endcapture(ms, s, p + 1);
+			case "$":
+				if(p + 1 === pat.length) return s === ms.src.length ? s : -1;
+				break;
+			case "%":
+				if(pat[p + 1] === "b") {
+					s = matchbalance(ms, s, p + 2);
+					if(s === -1) return -1;
+					p += 4;
+					continue;
+				}
+				if(pat[p + 1] === "f") {
+					p += 2;
+					if(pat[p] !== "[") error("missing '[' after '%f' in pattern");
+					const ep = classend(ms, p);
+					const prev = s === 0 ? 0 : ms.src.charCodeAt(s - 1);
+					const cur = s < ms.src.length ? ms.src.charCodeAt(s) : 0;
+					if(!matchbracket(ms, prev, p, ep - 1) && matchbracket(ms, cur, p, ep - 1)) {
+						p = ep;
+						continue;
+					}
+					return -1;
+				}
+				if(pat[p + 1] >= "0" && pat[p + 1] <= "9") {
+					s = matchcapture(ms, s, pat.charCodeAt(p + 1));
+					if(s === -1) return -1;
+					p += 2;
+					continue;
+				}
+				break;
+			default:
+				break;
+			}
+			const ep = classend(ms, p);
+			const m = singlematch(ms, s, p, ep);
+			switch(pat[ep]) {
+			case "?":
+				if(m) {
+					const r = domatch(ms, s + 1, ep + 1);
+					if(r !== -1) return r;
+				}
+				p = ep + 1;
+				continue;
+			case "+":
+				return m ? maxexpand(ms, s + 1, p, ep) : -1;
+			case "*":
+				return maxexpand(ms, s, p, ep);
+			case "-":
+				return minexpand(ms, s, p, ep);
+			default:
+				if(!m) return -1;
+				s++;
+				p = ep;
+				continue;
+			}
+		}
+		return s;
+	} finally {
+		ms.depth--;
+	}
+}
+
+function capture(ms, i, s, e) {
+	if(i >= ms.level) {
+		if(i === 0) return ms.src.slice(s, e);
+		error("invalid capture index %" + (i + 1));
+	}
+	const l = ms.len[i];
+	if(l === CAP_UNFINISHED) error("unfinished capture");
+	if(l === CAP_POSITION) return ms.start[i] + 1;
+	return ms.src.substr(ms.start[i], l);
+}
+
+/* the captures of a match, the whole match if there are none */
+function captures(ms, s, e, whole) {
+	const n = ms.level === 0 && whole ? 1 : ms.level;
+	const r = [];
+	for(let i = 0; i < n; i++) r.push(capture(ms, i, s, e));
+	return r;
+}
+
+const SPECIALS = /[\^$*+?.()[\]%-]/;
+
+function find(s, pat, init, plain) {
+	return strfind(s, pat, init, plain, true);
+}
+
+function match(s, pat, init) {
+	return strfind(s, pat, init, false, false);
+}
+
+function strfind(s, pat, init, plain, isfind) {
+	s = tostr(s);
+	pat = tostr(pat);
+	init = strindex(init === undefined ? 1 : init, s.length);
+	if(init < 1) init = 1;
+	if(init > s.length + 1) return undefined;
+	if(isfind && (plain === true || !SPECIALS.test(pat))) {
+		const i = s.indexOf(pat, init - 1);
+		return i < 0 ? undefined : [i + 1, i + pat.length];
+	}
+	const ms = new MatchState(s, pat);
+	const anchor = pat[0] === "^";
+	let si = init - 1;
+	const p = anchor ? 1 : 0;
+	do {
+		ms.level = 0;
+		const e = domatch(ms, si, p);
+		if(e !== -1) {
+			if(isfind) return [si + 1, e, ...captures(ms, -1, -1, false)];
+			const r = captures(ms, si, e, true);
+			return r.length === 1 ? r[0] : r;
+		}
+		si++;
+	} while(si <= s.length && !anchor);
+	return undefined;
+}
+
+function gmatch(s, pat) {
+	s = tostr(s);
+	pat = tostr(pat);
+	const ms = new MatchState(s, pat);
+	let si = 0, last = -1;
+	const iter = () => {
+		while(si <= s.length) {
+			ms.level = 0;
+			const e = domatch(ms, si, 0);
+			if(e !== -1 && e !== last) {
+				const start = si;
+				si = last = e;
+				return captures(ms, start, e, true);
+			}
+			si++;
+		}
+		return [undefined];
+	};
+	return [iter, undefined, undefined];
+}
+
+function gsub(s, pat, repl, max) {
+	s = tostr(s);
+	pat = tostr(pat);
+	const anchor = pat[0] === "^";
+	const p = anchor ? 1 : 0;
+	const ms = new MatchState(s, pat);
+	let si = 0, n = 0, last = -1, out = "";
+	if(max === undefined) max = s.length + 1;
+	while(n < max) {
+		ms.level = 0;
+		const e = domatch(ms, si, p);
+		if(e !== -1 && e !== last) {
+			n++;
+			out += replacement(ms, si, e, repl);
+			si = last = e;
+		} else if(si < s.length) {
+			out += s[si++];
+		} else {
+			break;
+		}
+		if(anchor) break;
+	}
+	return [out + s.slice(si), n];
+}
+
+function replacement(ms, s, e, repl) {
+	const whole = ms.src.slice(s, e);
+	let v;
+	switch(typeof repl) {
+	case "string":
+	case "number":
+	{
+		repl = tostr(repl);
+		let r = "";
+		for(let i = 0; i < repl.length; i++) {
+			const c = repl[i];
+			if(c !== "%") {
+				r += c;
+				continue;
+			}
+			const d = repl[++i];
+			if(d === "%") r += "%";
+			else if(d === "0") r += whole;
+			else if(d >= "1" && d <= "9") r += tostring(capture(ms, d.charCodeAt(0) - 49, s, e));
+			else error("invalid use of '%' in replacement string");
+		}
+		return r;
+	}
+	case "function":
+		v = first(repl(...captures(ms, s, e, true)));
+		break;
+	default:
+		v = index(repl, captures(ms, s, e, true)[0]);
+		break;
+	}
+	if(v === undefined || v === false) return whole;
+	if(typeof v === "string" || typeof v === "number") return tostr(v);
+	error("invalid replacement value (a " + type(v) + ")");
+}
+
+function reverse(s) {
+	s = tostr(s);
+	let r = "";
+	for(let i = s.length - 1; i >= 0; i--) r += s[i];
+	return r;
+}
+
+const string = lib({
+	len: (s) => tostr(s).length,
+	sub: sub,
+	upper: (s) => tostr(s).toUpperCase(),
+	lower: (s) => tostr(s).toLowerCase(),
+	rep: rep,
+	reverse: reverse,
+	byte: byte,
+	char: char,
+	format: format,
+	find: find,
+	match: match,
+	gmatch: gmatch,
+	gsub: gsub,
+});
+
+const stringmeta = lib({ __index: string });
+
+const math = lib({
+	abs: Math.abs,
+	ceil: Math.ceil,
+	floor: Math.floor,
+	sqrt: Math.sqrt,
+	sin: Math.sin,
+	cos: Math.cos,
+	tan: Math.tan,
+	asin: Math.asin,
+	acos: Math.acos,
+	atan: (y, x) => Math.atan2(y, x === undefined ? 1 : x),
+	exp: Math.exp,
+	log: (x, b) => b === undefined ? Math.log(x) : b === 2 ? Math.log2(x) : b === 10 ? Math.log10(x) : Math.log(x) / Math.log(b),
+	pow: Math.pow,
+	fmod: (a, b) => a % b,
+	modf: (x) => {
+		const i = x >= 0 ? Math.floor(x) : Math.ceil(x);
+		return [i, isFinite(x) ? x - i : 0];
+	},
+	max: Math.max,
+	min: Math.min,
+	random: (m, n) => {
+		const r = Math.random();
+		if(m === undefined) return r;
+		if(n === undefined) {
+			n = m;
+			m = 1;
+		}
+		return m + Math.floor(r * (n - m + 1));
+	},
+	randomseed: () => {},
+	tointeger: (x) => Number.isInteger(x) ? x : undefined,
+	type: (x) => typeof x !== "number" ? undefined : Number.isInteger(x) ? "integer" : "float",
+	huge: Infinity,
+	pi: Math.PI,
+	maxinteger: Number.MAX_SAFE_INTEGER,
+	mininteger: Number.MIN_SAFE_INTEGER,
+});
+
+const tablelib = lib({
+	insert: tinsert,
+	remove: tremove,
+	concat: tconcat,
+	sort: tsort,
+	unpack: unpack,
+	pack: tpack,
+});
+
+/* the lua globals, names the host already has are left alone */
+const globals = {
+	nil: nil,
+	print: print,
+	type: type,
+	tostring: tostring,
+	tonumber: tonumber,
+	pairs: pairs,
+	ipairs: ipairs,
+	next: next,
+	select: select,
+	rawget: rawget,
+	rawset: rawset,
+	rawlen: rawlen,
+	rawequal: rawequal,
+	setmetatable: setmetatable,
+	getmetatable: getmetatable,
+	assert: assert,
+	error: (msg) => error(msg),
+	pcall: pcall,
+	xpcall: xpcall,
+	unpack: unpack,
+	string: string,
+	math: math,
+	table: tablelib,
+};
+
+for(const name of Object.keys(globals)) {
+	if(!(name in globalThis)) globalThis[name] = globals[name];
+}
+
+module.exports = {
+	version: VERSION,
+	Table: Table,
+	LuaError: LuaError,
+	table: table,
+	data: data,
+	istable: istable,
+	rawget: rawget,
+	rawset: rawset,
+	rawlen: rawlen,
+	index: index,
+	setindex: setindex,
+	invoke: invoke,
+	call: call,
+	len: len,
+	concat: concat,
+	first: first,
+	values: values,
+	take: take,
+	rest: rest,
+	step: step,
+	key: key,
+	value: value,
+	walk: walk,
+	custom: custom,
+	pstep: pstep,
+	tostring: tostring,
+	string: string,
+};
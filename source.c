@@ -0,0 +1,124 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fox.h"
+#include "source.h"
+
+/* read buffer of the thread, reused by every small file */
+static __thread char *source_pool = NULL;
+static __thread size_t source_pool_cap = 0;
+
+static void source_pool_put(char *buf, size_t cap) {
+	if(source_pool) {
+		free(buf);
+		return;
+	}
+	source_pool = buf;
+	source_pool_cap = cap;
+}
+
+static int source_read(struct fox_source *s, int fd, size_t size, const char *filename) {
+	char *buf = source_pool;
+	size_t cap = source_pool_cap;
+	source_pool = NULL;
+	source_pool_cap = 0;
+	if(cap < size + 2) {
+		free(buf);
+		cap = size + 2 < 4096 ? 4096 : size + 2;
+		buf = malloc(cap);
+	}
+
+	//one read is enough unless the file grows meanwhile
+	size_t off = 0;
+	while(1) {
+		if(off + 2 == cap) {
+			cap *= 2;
+			buf = realloc(buf, cap);
+		}
+		ssize_t n = read(fd, buf + off, cap - 2 - off);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			log_error("read file failed %s: %s", filename, strerror(errno));
+			source_pool_put(buf, cap);
+			return 0;
+		}
+		if(n == 0) break;
+		off += n;
+	}
+	buf[off] = buf[off+1] = '\0';
+	s->data = buf;
+	s->len = off;
+	s->cap = cap;
+	s->mapped = 0;
+	return 1;
+}
+
+/* map the file privately, followed by zero pages for the end marks */
+static int source_map(struct fox_source *s, int fd, size_t size, const char *filename) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t maplen = (size + 2 + page - 1) & ~(page - 1);
+	char *base = mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED) {
+		log_error("mmap failed %s: %s", filename, strerror(errno));
+		return 0;
+	}
+	char *p = mmap(base, size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_FIXED | MAP_POPULATE, fd, 0);
+	if(p == MAP_FAILED) {
+		log_error("mmap failed %s: %s", filename, strerror(errno));
+		munmap(base, maplen);
+		return 0;
+	}
+	madvise(base, maplen, MADV_SEQUENTIAL);
+	s->data = base;
+	s->len = size;
+	s->cap = maplen;
+	s->mapped = 1;
+	return 1;
+}
+
+int source_open(struct fox_source *s, const char *filename) {
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		log_error("open file failed %s", filename);
+		return 0;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st)) {
+		log_error("stat file failed %s", filename);
+		close(fd);
+		return 0;
+	}
+
+	int val = 0;
+	if(S_ISREG(st.st_mode) && st.st_size >= SOURCE_MMAP_MIN) {
+		val = source_map(s, fd, st.st_size, filename);
+	} else {
+		val = source_read(s, fd, S_ISREG(st.st_mode) ? st.st_size : 0, filename);
+	}
+	close(fd);
+	return val;
+}
+
+void source_close(struct fox_source *s) {
+	if(!s->data) return;
+	if(s->mapped) {
+		munmap(s->data, s->cap);
+	} else {
+		source_pool_put(s->data, s->cap);
+	}
+	s->data = NULL;
+	s->len = 0;
+	s->cap = 0;
+}
+
+/* free the read buffer, threads call it before they exit */
+void source_trim() {
+	free(source_pool);
+	source_pool = NULL;
+	source_pool_cap = 0;
+}
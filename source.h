@@ -0,0 +1,24 @@
+#ifndef __SOURCE_H__
+#define __SOURCE_H__
+
+#include <stddef.h>
+
+/* files from this size on are mmapped, smaller ones are read */
+#define SOURCE_MMAP_MIN (64 * 1024)
+
+/*
+ * lua source loaded for the scanner. data is writable and followed by
+ * two zero bytes, so it can be scanned in place with yy_scan_buffer.
+ */
+struct fox_source {
+	char *data;
+	size_t len;
+	size_t cap;			/* bytes mapped or allocated at data */
+	int mapped;
+};
+
+int source_open(struct fox_source *s, const char *filename);
+void source_close(struct fox_source *s);
+void source_trim();
+
+#endif
@@ -0,0 +1,103 @@
+#include <time.h>
+
+#include "fox.h"
+#include "symbol.h"
+#include "syntax.h"
+#include "stats.h"
+
+void stats_init(struct fox_stats *s) {
+	memset(s, 0, sizeof(struct fox_stats));
+}
+
+double stats_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void stats_node(struct fox_stats *s, struct syntax_node *n) {
+	struct syntax_node *root = n;
+	while(n) {
+		s->nodes[n->type]++;
+		if(n->children) {
+			n = n->children;
+			continue;
+		}
+		while(n != root && !n->next) n = n->parent;
+		n = n == root ? NULL : n->next;
+	}
+}
+
+/* node counts by type and the shape of the block symbol tables */
+void stats_tree(struct fox_stats *s, struct syntax_tree *t) {
+	if(t->root) stats_node(s, t->root);
+	for(struct syntax_block *b = t->blocks; b; b = b->link) {
+		size_t chains = 0, max_chain = 0;
+		symbol_table_chains(b->symtab, &chains, &max_chain);
+		s->symtabs++;
+		s->symbols += b->symtab->count;
+		s->chains += chains;
+		if(b->symtab->count > s->max_symbols) s->max_symbols = b->symtab->count;
+		if(max_chain > s->max_chain) s->max_chain = max_chain;
+	}
+	s->memory += t->arena.allocated + t->strings.cap * sizeof(struct strpool_str *);
+}
+
+void stats_add(struct fox_stats *total, struct fox_stats *s) {
+	total->lex += s->lex;
+	total->parse += s->parse;
+	total->fold += s->fold;
+	total->symtab += s->symtab;
+	total->translate += s->translate;
+	total->write += s->write;
+	total->tokens += s->tokens;
+	for(int i = 0; i < STX_TYPE_COUNT; i++) total->nodes[i] += s->nodes[i];
+	total->symtabs += s->symtabs;
+	total->symbols += s->symbols;
+	total->chains += s->chains;
+	if(s->max_symbols > total->max_symbols) total->max_symbols = s->max_symbols;
+	if(s->max_chain > total->max_chain) total->max_chain = s->max_chain;
+	total->bytes_in += s->bytes_in;
+	total->bytes_out += s->bytes_out;
+	if(s->memory > total->memory) total->memory = s->memory;
+	total->files += s->files;
+	total->skipped += s->skipped;
+}
+
+void stats_write_string(FILE *fp, const char *str) {
+	fputc('"', fp);
+	for(const unsigned char *c = (const unsigned char *)str; *c; c++) {
+		if(*c == '"' || *c == '\\') fprintf(fp, "\\%c", *c);
+		else if(*c < 0x20) fprintf(fp, "\\u%04x", *c);
+		else fputc(*c, fp);
+	}
+	fputc('"', fp);
+}
+
+/* the members of one stats object, without the braces */
+void stats_write_json(FILE *fp, struct fox_stats *s, int indent) {
+	const char *pad = "                ";
+	int w = indent < 16 ? indent : 16;
+	fprintf(fp, "%.*s\"files\": %d,\n", w, pad, s->files);
+	fprintf(fp, "%.*s\"skipped\": %d,\n", w, pad, s->skipped);
+	fprintf(fp, "%.*s\"time_ms\": { \"lex\": %.3f, \"parse\": %.3f, \"fold\": %.3f, \"symtab\": %.3f, "
+			"\"translate\": %.3f, \"write\": %.3f },\n", w, pad,
+			s->lex * 1e3, s->parse * 1e3, s->fold * 1e3, s->symtab * 1e3,
+			s->translate * 1e3, s->write * 1e3);
+	fprintf(fp, "%.*s\"tokens\": %zu,\n", w, pad, s->tokens);
+
+	size_t nodes = 0;
+	fprintf(fp, "%.*s\"nodes\": { ", w, pad);
+	for(int i = 0; i < STX_TYPE_COUNT; i++) {
+		fprintf(fp, "\"%s\": %zu, ", syntax_node_type_string(i), s->nodes[i]);
+		nodes += s->nodes[i];
+	}
+	fprintf(fp, "\"total\": %zu },\n", nodes);
+
+	fprintf(fp, "%.*s\"symtabs\": { \"tables\": %zu, \"symbols\": %zu, \"max_symbols\": %zu, "
+			"\"chains\": %zu, \"max_chain\": %zu },\n", w, pad,
+			s->symtabs, s->symbols, s->max_symbols, s->chains, s->max_chain);
+	fprintf(fp, "%.*s\"bytes_in\": %zu,\n", w, pad, s->bytes_in);
+	fprintf(fp, "%.*s\"bytes_out\": %zu,\n", w, pad, s->bytes_out);
+	fprintf(fp, "%.*s\"memory\": %zu", w, pad, s->memory);
+}
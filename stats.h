@@ -0,0 +1,37 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+
+#include "syntax.h"
+
+/* what one file (or a whole run) cost, times are in seconds */
+struct fox_stats {
+	double lex;
+	double parse;		/* bison, without the time spent in the lexer */
+	double fold;
+	double symtab;
+	double translate;
+	double write;
+	size_t tokens;
+	size_t nodes[STX_TYPE_COUNT];
+	size_t symtabs;
+	size_t symbols;
+	size_t max_symbols;		/* symbols in the largest block table */
+	size_t chains;			/* distinct name hashes over all tables */
+	size_t max_chain;		/* most symbols sharing one hash */
+	size_t bytes_in;
+	size_t bytes_out;
+	size_t memory;			/* syntax tree plus output buffer, the largest file in a total */
+	int files;
+	int skipped;
+};
+
+void stats_init(struct fox_stats *s);
+double stats_now();
+void stats_tree(struct fox_stats *s, struct syntax_tree *t);
+void stats_add(struct fox_stats *total, struct fox_stats *s);
+void stats_write_json(FILE *fp, struct fox_stats *s, int indent);
+void stats_write_string(FILE *fp, const char *str);
+
+#endif
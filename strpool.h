@@ -0,0 +1,129 @@
+#ifndef __STRPOOL_H__
+#define __STRPOOL_H__
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "hmap.h"
+
+/* interned string, the handle given out is the str member */
+struct strpool_str {
+	size_t hash;
+	size_t len;
+	char str[];
+};
+
+/* string interning table, each distinct string is stored once in the arena
+   so interned strings can be compared by address */
+struct strpool {
+	struct arena *arena;
+	struct strpool_str **slots;
+	size_t cap;		/* power of 2 */
+	size_t count;
+};
+
+#define STRPOOL_INIT_CAP 256
+
+static inline struct strpool_str *strpool_entry(const char *s) {
+	return (struct strpool_str *)(s - offsetof(struct strpool_str, str));
+}
+
+static inline size_t strpool_len(const char *s) {
+	return strpool_entry(s)->len;
+}
+
+static inline size_t strpool_hash(const char *s) {
+	return strpool_entry(s)->hash;
+}
+
+static inline void strpool_init(struct strpool *p, struct arena *a) {
+	p->arena = a;
+	p->cap = STRPOOL_INIT_CAP;
+	p->count = 0;
+	p->slots = calloc(p->cap, sizeof(struct strpool_str *));
+}
+
+static inline void strpool_release(struct strpool *p) {
+	free(p->slots);
+	p->slots = NULL;
+	p->cap = 0;
+	p->count = 0;
+}
+
+/* forget every string but keep the slots, the arena is reset by its owner */
+static inline void strpool_reset(struct strpool *p) {
+	memset(p->slots, 0, p->cap * sizeof(struct strpool_str *));
+	p->count = 0;
+}
+
+static inline void strpool_grow(struct strpool *p) {
+	size_t cap = p->cap * 2;
+	struct strpool_str **slots = calloc(cap, sizeof(struct strpool_str *));
+	for(size_t i = 0; i < p->cap; i++) {
+		struct strpool_str *e = p->slots[i];
+		if(!e) continue;
+		size_t idx = e->hash & (cap - 1);
+		while(slots[idx]) idx = (idx + 1) & (cap - 1);
+		slots[idx] = e;
+	}
+	free(p->slots);
+	p->slots = slots;
+	p->cap = cap;
+}
+
+/* the interned copy of s, NULL if it was never interned */
+static inline char *strpool_find(struct strpool *p, const char *s, size_t l) {
+	size_t hash = hash_bytes(s, l, 0);
+	size_t idx = hash & (p->cap - 1);
+	struct strpool_str *e;
+	while((e = p->slots[idx]) != NULL) {
+		if(e->hash == hash && e->len == l && !memcmp(e->str, s, l)) {
+			return e->str;
+		}
+		idx = (idx + 1) & (p->cap - 1);
+	}
+	return NULL;
+}
+
+static inline char *strpool_intern(struct strpool *p, const char *s, size_t l) {
+	size_t hash = hash_bytes(s, l, 0);
+	size_t idx = hash & (p->cap - 1);
+	struct strpool_str *e;
+	while((e = p->slots[idx]) != NULL) {
+		if(e->hash == hash && e->len == l && !memcmp(e->str, s, l)) {
+			return e->str;
+		}
+		idx = (idx + 1) & (p->cap - 1);
+	}
+
+	e = arena_alloc(p->arena, sizeof(struct strpool_str) + l + 1);
+	e->hash = hash;
+	e->len = l;
+	memcpy(e->str, s, l);
+	e->str[l] = '\0';
+	p->slots[idx] = e;
+	if(++p->count * 2 > p->cap) strpool_grow(p);
+	return e->str;
+}
+
+static inline char *strpool_intern_str(struct strpool *p, const char *s) {
+	if(!s) return NULL;
+	return strpool_intern(p, s, strlen(s));
+}
+
+/* intern prefix+s, only copies when the joined string is new */
+static inline char *strpool_intern_prefix(struct strpool *p, const char *prefix,
+										  const char *s, size_t l) {
+	size_t pl = strlen(prefix);
+	char tmp[256];
+	char *buf = pl + l < sizeof(tmp) ? tmp : malloc(pl + l + 1);
+	memcpy(buf, prefix, pl);
+	memcpy(buf + pl, s, l);
+	char *d = strpool_intern(p, buf, pl + l);
+	if(buf != tmp) free(buf);
+	return d;
+}
+
+#endif
@@ -1,71 +1,194 @@
 #include "fox.h"
 #include "list.h"
 #include "hmap.h"
+#include "strpool.h"
 #include "symbol.h"
 
-static void clear_handler(size_t key, void *value) {
-	symbol_release(value);
+static inline size_t symbol_hash(struct symbol_table *t, const char *name) {
+	//one wyhash mix, the seed has to reach every bit of the key
+	if(t->interned) return hash_wymix(strpool_hash(name) ^ t->seed, hash_wyp[1] ^ t->seed);
+	return hash_bytes(name, strlen(name), t->seed);
+}
+
+static inline int symbol_name_equal(const char *a, const char *b) {
+	//interned names are usually the same pointer
+	return a == b || !strcmp(a, b);
 }
 
 struct symbol *symbol_create(const char *name, void *udata) {
 	struct symbol *s = malloc(sizeof(struct symbol));
-	s->name = fox_strdup(name);
+	s->name = name;
 	s->udata = udata;
+	s->next = NULL;
 	return s;
 }
 
 void symbol_release(struct symbol *s) {
-	free(s->name);
 	free(s);
 }
 
 struct symbol_table *symbol_table_create() {
 	struct symbol_table *t = malloc(sizeof(struct symbol_table));
-	t->m = malloc(sizeof(struct hmap));
-	hmap_init(t->m, 256);
+	t->m = NULL;
+	list_init(&t->order);
+	t->seed = hmap_hash(HKEY_PTR(t));
+	t->count = 0;
+	t->interned = 0;
+	return t;
+}
+
+struct symbol_table *symbol_table_create_interned() {
+	struct symbol_table *t = symbol_table_create();
+	t->interned = 1;
 	return t;
 }
 
 void symbol_table_release(struct symbol_table *t) {
-	hmap_clear(t->m, clear_handler);
-	free(t->m);
+	struct lnode *n = list_begin(&t->order);
+	while(n != list_end(&t->order)) {
+		struct symbol *s = (struct symbol *)n;
+		n = list_next(n);
+		symbol_release(s);
+	}
+	if(t->m) {
+		hmap_clear(t->m, NULL);
+		free(t->m);
+	}
 	free(t);
 }
 
-void symbol_table_insert(struct symbol_table *t, struct symbol *s) {
-	if(!s || !s->name) return;
-	hmap_insert(t->m, HKEY_STR(s->name), s);
+static int symbol_table_small_index(struct symbol_table *t, const char *name) {
+	for(size_t i = 0; i < t->count; i++) {
+		if(symbol_name_equal(t->small[i]->name, name)) return i;
+	}
+	return -1;
+}
+
+static struct symbol *symbol_table_find(struct symbol_table *t, const char *name,
+										size_t key, struct symbol **head) {
+	*head = NULL;
+	hmap_get(t->m, key, (void **)head);
+	struct symbol *s = *head;
+	while(s && !symbol_name_equal(s->name, name)) s = s->next;
+	return s;
+}
+
+/* move every symbol into a map once the inline slots run out */
+static void symbol_table_grow(struct symbol_table *t) {
+	t->m = malloc(sizeof(struct hmap));
+	hmap_init(t->m, SYMBOL_TABLE_SMALL * 4);
+	for(size_t i = 0; i < t->count; i++) {
+		struct symbol *s = t->small[i];
+		size_t key = symbol_hash(t, s->name);
+		struct symbol *head = NULL;
+		if(hmap_get(t->m, key, (void **)&head)) {
+			s->next = head->next;
+			head->next = s;
+		} else {
+			s->next = NULL;
+			hmap_insert(t->m, key, s);
+		}
+	}
+}
+
+int symbol_table_insert(struct symbol_table *t, struct symbol *s) {
+	if(!s || !s->name) return 0;
+	if(!t->m) {
+		if(symbol_table_small_index(t, s->name) >= 0) return 0;
+		if(t->count < SYMBOL_TABLE_SMALL) {
+			s->next = NULL;
+			t->small[t->count++] = s;
+			list_push_tail(&t->order, &s->n);
+			return 1;
+		}
+		symbol_table_grow(t);
+	}
+
+	size_t key = symbol_hash(t, s->name);
+	struct symbol *head = NULL;
+	if(symbol_table_find(t, s->name, key, &head)) return 0;
+
+	if(head) {
+		s->next = head->next;
+		head->next = s;
+	} else {
+		s->next = NULL;
+		hmap_insert(t->m, key, s);
+	}
+	list_push_tail(&t->order, &s->n);
+	t->count++;
+	return 1;
 }
 
 void symbol_table_remove(struct symbol_table *t, struct symbol *s) {
-	if(!s || !s->name) return;	
-	hmap_remove(t->m, HKEY_STR(s->name), NULL);
+	if(!s || !s->name) return;
+	if(!t->m) {
+		int i = symbol_table_small_index(t, s->name);
+		if(i < 0) return;
+		struct symbol *c = t->small[i];
+		memmove(&t->small[i], &t->small[i+1], (t->count - i - 1) * sizeof(struct symbol *));
+		list_remove(&c->n);
+		t->count--;
+		return;
+	}
+
+	size_t key = symbol_hash(t, s->name);
+	struct symbol *head = NULL;
+	struct symbol *c = symbol_table_find(t, s->name, key, &head);
+	if(!c) return;
+
+	if(c == head) {
+		hmap_remove(t->m, key, NULL);
+		if(c->next) hmap_insert(t->m, key, c->next);
+	} else {
+		struct symbol *p = head;
+		while(p->next != c) p = p->next;
+		p->next = c->next;
+	}
+	c->next = NULL;
+	list_remove(&c->n);
+	t->count--;
 }
 
 struct symbol *symbol_table_get(struct symbol_table *t, const char *name) {
 	if(!name) return NULL;
-	struct symbol *s = NULL;
-	hmap_get(t->m, HKEY_STR(name), HVALUE_PTR(s));
-	return s;
+	if(!t->m) {
+		int i = symbol_table_small_index(t, name);
+		return i < 0 ? NULL : t->small[i];
+	}
+	struct symbol *head = NULL;
+	return symbol_table_find(t, name, symbol_hash(t, name), &head);
 }
 
 struct symbol *symbol_table_set(struct symbol_table *t, struct symbol *s) {
 	if(!s || !s->name) return NULL;
-	struct symbol *ps = NULL;
-	int key = HKEY_STR(s->name);
-	hmap_remove(t->m, key, HVALUE_PTR(ps));
-	hmap_insert(t->m, key, s);
+	struct symbol *ps = symbol_table_get(t, s->name);
+	if(ps) symbol_table_remove(t, ps);
+	symbol_table_insert(t, s);
 	return ps;
 }
 
-static symbol_handler walkhandler = NULL;
-static void walk_handler(size_t key, void *value) {
-	struct symbol *s = value;
-	if(walkhandler) walkhandler(s->name, s);
+/* number of distinct name hashes and the longest run sharing one */
+void symbol_table_chains(struct symbol_table *t, size_t *chains, size_t *max_chain) {
+	if(!t->m) {
+		*chains = t->count;
+		*max_chain = t->count ? 1 : 0;
+		return;
+	}
+	*chains = t->m->count;
+	*max_chain = 0;
+	for(size_t i = 0; i < t->m->cap; i++) {
+		struct hslot *slot = &t->m->slots[i];
+		if(!slot->hash) continue;
+		size_t len = 0;
+		for(struct symbol *s = slot->value; s; s = s->next) len++;
+		if(len > *max_chain) *max_chain = len;
+	}
 }
 
 void symbol_table_walk(struct symbol_table *t, symbol_handler h) {
-	walkhandler = h;
-	hmap_foreach(t->m, walk_handler);
-	walkhandler = NULL;
+	for(struct lnode *n = list_begin(&t->order); n != list_end(&t->order); n = list_next(n)) {
+		struct symbol *s = (struct symbol *)n;
+		h(s->name, s);
+	}
 }
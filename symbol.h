@@ -1,25 +1,45 @@
 #ifndef __SYMBOL_H__
 #define __SYMBOL_H__
 
+#include "list.h"
+
 struct symbol {
-	char *name;	/* used as hmap key */
+	struct lnode n;			/* insertion order in the table */
+	const char *name;
 	void *udata;
+	struct symbol *next;	/* symbols sharing the same name hash */
 };
 
 struct symbol *symbol_create(const char *name, void *udata);
 void symbol_release(struct symbol *s);
 
+#define SYMBOL_TABLE_SMALL 8
+
+/*
+ * keyed on the full name. the first SYMBOL_TABLE_SMALL symbols are kept
+ * inline and searched linearly, past that the table switches to a map
+ * hashed with a per-table seed. an interned table takes only strpool
+ * names, their stored hash is used instead of hashing the bytes again.
+ */
 struct symbol_table {
-	struct hmap *m;
+	struct hmap *m;			/* name hash -> symbol chain, NULL while small */
+	struct symbol *small[SYMBOL_TABLE_SMALL];
+	struct list order;
+	size_t seed;
+	size_t count;
+	int interned;
 };
 
 struct symbol_table *symbol_table_create();
+struct symbol_table *symbol_table_create_interned();
 void symbol_table_release(struct symbol_table *t);
-void symbol_table_insert(struct symbol_table *t, struct symbol *s);
+int symbol_table_insert(struct symbol_table *t, struct symbol *s);
 void symbol_table_remove(struct symbol_table *t, struct symbol *s);
 struct symbol *symbol_table_get(struct symbol_table *t, const char *name);
 struct symbol *symbol_table_set(struct symbol_table *t, struct symbol *s);
 
+void symbol_table_chains(struct symbol_table *t, size_t *chains, size_t *max_chain);
+
 typedef void (*symbol_handler)(const char *name, struct symbol *s);
 void symbol_table_walk(struct symbol_table *t, symbol_handler h);
 
@@ -1,17 +1,62 @@
+#include <errno.h>
+
 #include "fox.h"
 #include "syntax.h"
 #include "symbol.h"
 
+/* the last released tree of each thread, its arena chunk and string
+   slots are reused by the next parse so they stay warm */
+static __thread struct syntax_tree *spare_tree = NULL;
+
 struct syntax_tree *syntax_tree_create() {
-	struct syntax_tree *t = malloc(sizeof(struct syntax_tree));
+	struct syntax_tree *t = spare_tree;
+	if(t) {
+		spare_tree = NULL;
+		return t;
+	}
+
+	t = malloc(sizeof(struct syntax_tree));
 	t->root = NULL;
+	arena_init(&t->arena, SYNTAX_ARENA_CHUNK);
+	strpool_init(&t->strings, &t->arena);
+	t->blocks = NULL;
+	t->nodes = 0;
+	t->regs = 0;
 	return t;
 }
 
+static void syntax_tree_free(struct syntax_tree *t) {
+	strpool_release(&t->strings);
+	arena_release(&t->arena);
+	free(t);
+}
+
 void syntax_tree_release(struct syntax_tree *t) {
 	if(!t) return;
-	if(t->root)	syntax_node_release(t->root);
-	free(t);
+	struct syntax_block *b = t->blocks;
+	while(b) {
+		symbol_table_release(b->symtab);
+		b = b->link;
+	}
+	if(spare_tree) {
+		syntax_tree_free(t);
+		return;
+	}
+
+	t->root = NULL;
+	t->blocks = NULL;
+	t->nodes = 0;
+	t->regs = 0;
+	strpool_reset(&t->strings);
+	arena_reset(&t->arena);
+	spare_tree = t;
+}
+
+/* free the spare tree, threads call it before they exit */
+void syntax_tree_trim() {
+	if(!spare_tree) return;
+	syntax_tree_free(spare_tree);
+	spare_tree = NULL;
 }
 
 void syntax_tree_walk(struct syntax_tree *t, syntax_node_handler h) {
@@ -19,67 +64,102 @@ void syntax_tree_walk(struct syntax_tree *t, syntax_node_handler h) {
 	syntax_node_walk(t->root, h);
 }
 
+size_t syntax_tree_bytes(struct syntax_tree *t) {
+	return t->arena.used;
+}
+
+size_t syntax_tree_node_count(struct syntax_tree *t) {
+	return t->nodes;
+}
+
+char *syntax_tree_strdup(struct syntax_tree *t, const char *s) {
+	return arena_strdup(&t->arena, s);
+}
+
+char *syntax_tree_strndup(struct syntax_tree *t, const char *s, size_t l) {
+	return arena_strndup(&t->arena, s, l);
+}
+
+char *syntax_tree_intern(struct syntax_tree *t, const char *s, size_t l) {
+	return strpool_intern(&t->strings, s, l);
+}
+
+char *syntax_tree_strjoin(struct syntax_tree *t, const char *s0, const char *sep, const char *s1) {
+	return arena_strjoin(&t->arena, s0, sep, s1);
+}
+
+static void *syntax_tree_alloc_node(struct syntax_tree *t, size_t size) {
+	t->nodes++;
+	return arena_alloc(&t->arena, size);
+}
+
 void syntax_node_init(struct syntax_node *n, enum syntax_node_type ty) {
 	n->next = NULL;
 	n->parent = NULL;
 	n->children = NULL;
+	n->last = n;
 	n->type = ty;
 	n->lineno = 0;
+	n->count = 0;
 }
 
-void syntax_node_push_child_head(struct syntax_node *p, struct syntax_node *c) {
-	struct syntax_node *pc = c;
-	struct syntax_node *cc = pc->next;
-	c->parent = p;
-	while(cc) {
+/*
+ * tail of the run headed by n. runs only ever grow, so a stale last
+ * (n got linked behind another node) still points into the run and
+ * is moved forward here.
+ */
+static struct syntax_node *syntax_node_run_tail(struct syntax_node *n) {
+	struct syntax_node *l = n->last;
+	while(l->next) l = l->next;
+	n->last = l;
+	return l;
+}
+
+/* adopt the run headed by c, returns its length */
+static int syntax_node_adopt(struct syntax_node *p, struct syntax_node *c) {
+	int cnt = 0;
+	for(struct syntax_node *cc = c; cc; cc = cc->next) {
 		cc->parent = p;
-		pc = cc;
-		cc = pc->next;
+		cnt++;
 	}
-	pc->next = p->children;
-	p->children = c;
+	return cnt;
 }
 
-void syntax_node_push_child_tail(struct syntax_node *p, struct syntax_node *c) {
-	struct syntax_node *cc = c;
-	while(cc) {
-		cc->parent = p;
-		cc = cc->next;
+void syntax_node_push_child_head(struct syntax_node *p, struct syntax_node *c) {
+	p->count += syntax_node_adopt(p, c);
+	struct syntax_node *pc = syntax_node_run_tail(c);
+	if(p->children) {
+		pc->next = p->children;
+		c->last = syntax_node_run_tail(p->children);
 	}
+	p->children = c;
+}
 
+void syntax_node_push_child_tail(struct syntax_node *p, struct syntax_node *c) {
+	p->count += syntax_node_adopt(p, c);
 	if(!p->children) {
 		p->children = c;
 		return;
 	}
 
-	struct syntax_node *pp = p->children;
-	struct syntax_node *pn = pp->next;
-	while(pn) {
-		pp = pn;
-		pn = pn->next;
-	}
-	pp->next = c;
+	struct syntax_node *pc = syntax_node_run_tail(p->children);
+	pc->next = c;
+	p->children->last = syntax_node_run_tail(c);
 }
 
 void syntax_node_push_sibling_head(struct syntax_node *p, struct syntax_node *c) {
-	struct syntax_node *pc = c;
-	struct syntax_node *cc = pc->next;
-	while(cc) {
-		pc = cc;
-		cc = pc->next;
-	}
+	if(p->parent) p->parent->count += syntax_node_adopt(p->parent, c);
+	struct syntax_node *pc = syntax_node_run_tail(c);
 	pc->next = p->next;
 	p->next = c;
+	if(p->last == p) p->last = pc;
 }
 
 void syntax_node_push_sibling_tail(struct syntax_node *p, struct syntax_node *c) {
-	struct syntax_node *pc = p;
-	struct syntax_node *cc = pc->next;
-	while(cc) {
-		pc = cc;
-		cc = pc->next;
-	}
+	if(p->parent) p->parent->count += syntax_node_adopt(p->parent, c);
+	struct syntax_node *pc = syntax_node_run_tail(p);
 	pc->next = c;
+	p->last = syntax_node_run_tail(c);
 }
 
 int syntax_node_depth(struct syntax_node *n) {
@@ -93,13 +173,7 @@ int syntax_node_depth(struct syntax_node *n) {
 }
 
 int syntax_node_children_count(struct syntax_node *n) {
-	int d = 0;
-	struct syntax_node *p = n->children;
-	while(p) {
-		d++;
-		p = p->next;
-	}
-	return d;
+	return n->count;
 }
 
 int syntax_node_sibling_count(struct syntax_node *n) {
@@ -114,6 +188,9 @@ int syntax_node_sibling_count(struct syntax_node *n) {
 
 struct syntax_node *syntax_node_child(struct syntax_node *n, int index)
 {
+	if(index < 0 || index >= n->count) return NULL;
+	if(index == n->count - 1) return syntax_node_run_tail(n->children);
+
 	int idx = 0;
 	struct syntax_node *p = n->children;
 	while(idx < index && p) {
@@ -134,12 +211,17 @@ struct syntax_node *syntax_node_sibling(struct syntax_node *n, int index)
 	return idx == index ? p : NULL;
 }
 
+/* pre-order, climbing back through parents instead of recursing */
 void syntax_node_walk(struct syntax_node *n, syntax_node_handler h) {
-	h(n);
-	struct syntax_node *c = n->children;
-	while(c) {
-		syntax_node_walk(c, h);
-		c = c->next;
+	struct syntax_node *root = n;
+	while(n) {
+		h(n);
+		if(n->children) {
+			n = n->children;
+			continue;
+		}
+		while(n != root && !n->next) n = n->parent;
+		n = n == root ? NULL : n->next;
 	}
 }
 
@@ -148,7 +230,7 @@ static char* syntax_node_type_name[] = {
 	"block",
 	"statement",
 	"expression",
-	"varaible",
+	"variable",
 	"function",
 	"function_call",
 	"argument",
@@ -250,6 +332,17 @@ const char *syntax_variable_tag_string(enum syntax_variable_tag tag) {
 	return syntax_variable_tag_name[tag];
 }
 
+static char *syntax_binding_name[] = {
+	"none",
+	"local",
+	"upvalue",
+	"global"
+};
+
+const char *syntax_binding_string(enum syntax_binding bind) {
+	return syntax_binding_name[bind];
+}
+
 static char *syntax_argument_tag_name[] = {
 	"invalid",
 	"empty argument",
@@ -306,185 +399,133 @@ int func_scope(struct syntax_node *n) {
 	return 1;
 }
 
-static void syntax_node_release_children(struct syntax_node *n) {
-	struct syntax_node *c = n->children;
-	while(c) {
-		struct syntax_node *cc = c;
-		c = c->next;
-		syntax_node_release(cc);
-	}
-}
-
-void syntax_node_release(struct syntax_node *n) {
-	void *node = n;
-	switch(n->type) {
-	case STX_CHUNK:
-		release_syntax_chunk(node);
-		break;
-	case STX_BLOCK:
-		release_syntax_block(node);
-		break;
-	case STX_STATEMENT:
-		release_syntax_statement(node);
-		break;
-	case STX_FUNCTION:
-		release_syntax_function(node);
-		break;
-	case STX_FUNCTIONCALL:
-		release_syntax_functioncall(node);
-		break;
-	case STX_EXPRESSION:
-		release_syntax_expression(node);
-		break;
-	case STX_TABLE:
-		release_syntax_table(node);
-		break;
-	case STX_FIELD:
-		release_syntax_field(node);
-		break;
-	case STX_VARIABLE:
-		release_syntax_variable(node);
-		break;
-	case STX_ARGUMENT:
-		release_syntax_argument(node);
-		break;
-	default:
-		log_warn("unknown syntax node type to release:%d", n->type);
-		syntax_node_release_children(n);
-		free(n);
-		break;
-	}
-}
-
-struct syntax_chunk *create_syntax_chunk() {
-	struct syntax_chunk *chunk = malloc(sizeof(struct syntax_chunk));
+struct syntax_chunk *create_syntax_chunk(struct syntax_tree *t) {
+	struct syntax_chunk *chunk = syntax_tree_alloc_node(t, sizeof(struct syntax_chunk));
 	syntax_node_init(&chunk->n, STX_CHUNK);
 	return chunk;
 }
 
-void release_syntax_chunk(struct syntax_chunk *chunk) {
-	syntax_node_release_children(&chunk->n);
-	free(chunk);
-}
-
-struct syntax_block *create_syntax_block() {
-	struct syntax_block *block = malloc(sizeof(struct syntax_block));
+struct syntax_block *create_syntax_block(struct syntax_tree *t) {
+	struct syntax_block *block = syntax_tree_alloc_node(t, sizeof(struct syntax_block));
 	syntax_node_init(&block->n, STX_BLOCK);
-	block->symtab = symbol_table_create();
+	block->symtab = NULL;
+	block->link = NULL;
 	return block;
 }
 
-void release_syntax_block(struct syntax_block *block) {
-	syntax_node_release_children(&block->n);
-	symbol_table_release(block->symtab);
-	free(block);	
+/* most blocks never declare anything, their table is made on first use */
+struct symbol_table *syntax_block_symbol_table(struct syntax_tree *t, struct syntax_block *b) {
+	if(!b->symtab) {
+		b->symtab = symbol_table_create_interned();
+		b->link = t->blocks;
+		t->blocks = b;
+	}
+	return b->symtab;
 }
 
-struct syntax_statement *create_syntax_statement() {
-	struct syntax_statement *stmt = malloc(sizeof(struct syntax_statement));
+struct syntax_statement *create_syntax_statement(struct syntax_tree *t) {
+	struct syntax_statement *stmt = syntax_tree_alloc_node(t, sizeof(struct syntax_statement));
 	syntax_node_init(&stmt->n, STX_STATEMENT);
 	stmt->tag = STMT_INVALID;
 	stmt->value.name = NULL;
 	return stmt;
 }
 
-void release_syntax_statement(struct syntax_statement *stmt) {
-	syntax_node_release_children(&stmt->n);
-	free(stmt->value.name);
-	free(stmt);
-}
-
-struct syntax_expression *create_syntax_expression() {
-	struct syntax_expression *exp = malloc(sizeof(struct syntax_expression));
+struct syntax_expression *create_syntax_expression(struct syntax_tree *t) {
+	struct syntax_expression *exp = syntax_tree_alloc_node(t, sizeof(struct syntax_expression));
 	syntax_node_init(&exp->n, STX_EXPRESSION);
 	exp->tag = EXP_INVALID;
+	exp->isint = 0;
 	exp->value.string = NULL;
+	exp->num.integer = 0;
 	return exp;
 }
 
-void release_syntax_expression(struct syntax_expression *exp) {
-	syntax_node_release_children(&exp->n);
-	free(exp->value.string);
-	free(exp);	
+/*
+ * numeral as lua reads it: decimal without fraction or exponent is an
+ * integer unless it overflows, hex integers wrap around, the rest are
+ * floats.
+ */
+struct syntax_expression *create_syntax_number(struct syntax_tree *t, const char *s, size_t l) {
+	struct syntax_expression *exp = create_syntax_expression(t);
+	exp->tag = EXP_NUMBER;
+	exp->value.string = strpool_intern(&t->strings, s, l);
+
+	const char *p = exp->value.string;
+	if(l > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+		unsigned long long v = 0;
+		for(size_t i = 2; i < l; i++) {
+			char c = p[i];
+			int d = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+			v = v * 16 + d;
+		}
+		exp->isint = 1;
+		exp->num.integer = (long long)v;
+	} else if(!strpbrk(p, ".eE")) {
+		errno = 0;
+		long long v = strtoll(p, NULL, 10);
+		if(errno == ERANGE) {
+			exp->num.number = strtod(p, NULL);
+		} else {
+			exp->isint = 1;
+			exp->num.integer = v;
+		}
+	} else {
+		exp->num.number = strtod(p, NULL);
+	}
+	return exp;
 }
 
-struct syntax_variable *create_syntax_variable() {
-	struct syntax_variable *var = malloc(sizeof(struct syntax_variable));
+struct syntax_variable *create_syntax_variable(struct syntax_tree *t) {
+	struct syntax_variable *var = syntax_tree_alloc_node(t, sizeof(struct syntax_variable));
 	syntax_node_init(&var->n, STX_VARIABLE);
 	var->tag = VAR_INVALID;
 	var->name = NULL;
+	var->bind = BIND_NONE;
+	var->slot = -1;
 	return var;
 }
 
-void release_syntax_variable(struct syntax_variable *var) {
-	syntax_node_release_children(&var->n);
-	free(var->name);
-	free(var);
-}
-
-struct syntax_function *create_syntax_function() {
-	struct syntax_function *func = malloc(sizeof(struct syntax_function));
+struct syntax_function *create_syntax_function(struct syntax_tree *t) {
+	struct syntax_function *func = syntax_tree_alloc_node(t, sizeof(struct syntax_function));
 	syntax_node_init(&func->n, STX_FUNCTION);
 	func->name = NULL;
 	func->pars = NULL;
+	func->bind = BIND_NONE;
+	func->slot = -1;
+	func->nrets = 0;
+	func->direct = 0;
+	func->spread = 0;
 	return func;
 }
 
-void release_syntax_function(struct syntax_function *func) {
-	syntax_node_release_children(&func->n);
-	free(func->name);
-	free(func->pars);
-	free(func);
-}
-
-struct syntax_functioncall *create_syntax_functioncall() {
-	struct syntax_functioncall *fcall = malloc(sizeof(struct syntax_functioncall));
+struct syntax_functioncall *create_syntax_functioncall(struct syntax_tree *t) {
+	struct syntax_functioncall *fcall = syntax_tree_alloc_node(t, sizeof(struct syntax_functioncall));
 	syntax_node_init(&fcall->n, STX_FUNCTIONCALL);
 	fcall->name = NULL;
+	fcall->callee = NULL;
 	return fcall;
 }
 
-void release_syntax_functioncall(struct syntax_functioncall *fcall) {
-	syntax_node_release_children(&fcall->n);
-	free(fcall->name);
-	free(fcall);
-}
-
-struct syntax_argument *create_syntax_argument() {
-	struct syntax_argument *arg = malloc(sizeof(struct syntax_argument));
+struct syntax_argument *create_syntax_argument(struct syntax_tree *t) {
+	struct syntax_argument *arg = syntax_tree_alloc_node(t, sizeof(struct syntax_argument));
 	syntax_node_init(&arg->n, STX_ARGUMENT);
 	arg->tag = ARG_INVALID;
 	arg->name = NULL;
 	return arg;
 }
 
-void release_syntax_argument(struct syntax_argument *arg) {
-	syntax_node_release_children(&arg->n);
-	free(arg->name);
-	free(arg);
-}
-
-struct syntax_table *create_syntax_table() {
-	struct syntax_table *table = malloc(sizeof(struct syntax_table));
+struct syntax_table *create_syntax_table(struct syntax_tree *t) {
+	struct syntax_table *table = syntax_tree_alloc_node(t, sizeof(struct syntax_table));
 	syntax_node_init(&table->n, STX_TABLE);
+	table->json = TABLE_JSON_UNKNOWN;
 	return table;
 }
 
-void release_syntax_table(struct syntax_table *table) {
-	syntax_node_release_children(&table->n);
-	free(table);
-}
-
-struct syntax_field *create_syntax_field() {
-	struct syntax_field *field = malloc(sizeof(struct syntax_field));
+struct syntax_field *create_syntax_field(struct syntax_tree *t) {
+	struct syntax_field *field = syntax_tree_alloc_node(t, sizeof(struct syntax_field));
 	syntax_node_init(&field->n, STX_FIELD);
 	field->tag = FIELD_INVALID;
 	field->name = NULL;
 	return field;
 }
-
-void release_syntax_field(struct syntax_field *field) {
-	syntax_node_release_children(&field->n);
-	free(field->name);
-	free(field);
-}
@@ -1,6 +1,11 @@
 #ifndef __SYNTAX_H__
 #define __SYNTAX_H__
 
+#include "arena.h"
+#include "strpool.h"
+
+#define SYNTAX_ARENA_CHUNK (64 * 1024)
+
 enum syntax_node_type {
 	STX_CHUNK,
 	STX_BLOCK,
@@ -14,14 +19,18 @@ enum syntax_node_type {
 	STX_FIELD,
 };
 
+#define STX_TYPE_COUNT (STX_FIELD + 1)
+
 const char *syntax_node_type_string(enum syntax_node_type ty);
 
 struct syntax_node {
 	struct syntax_node *next;
 	struct syntax_node *parent;
 	struct syntax_node *children;
+	struct syntax_node *last;	/* tail of the sibling run this node heads */
 	enum syntax_node_type type;
 	int lineno;
+	int count;					/* children */
 };
 
 typedef void (*syntax_node_handler)(struct syntax_node *n);
@@ -37,15 +46,27 @@ int syntax_node_sibling_count(struct syntax_node *n);
 struct syntax_node *syntax_node_child(struct syntax_node *n, int index);
 struct syntax_node *syntax_node_sibling(struct syntax_node *n, int index);
 void syntax_node_walk(struct syntax_node *n, syntax_node_handler h);
-void syntax_node_release(struct syntax_node *n);
 
+/* all nodes and their strings live in the tree arena */
 struct syntax_tree {
 	struct syntax_node *root;
+	struct arena arena;
+	struct strpool strings;		/* interned names and literals */
+	struct syntax_block *blocks;	/* blocks with a symbol table */
+	size_t nodes;
+	int regs;		/* widest return through the register, 0 if unused */
 };
 
 struct syntax_tree *syntax_tree_create();
 void syntax_tree_release(struct syntax_tree *t);
+void syntax_tree_trim();
 void syntax_tree_walk(struct syntax_tree *t, syntax_node_handler h);
+size_t syntax_tree_bytes(struct syntax_tree *t);
+size_t syntax_tree_node_count(struct syntax_tree *t);
+char *syntax_tree_strdup(struct syntax_tree *t, const char *s);
+char *syntax_tree_strndup(struct syntax_tree *t, const char *s, size_t l);
+char *syntax_tree_intern(struct syntax_tree *t, const char *s, size_t l);
+char *syntax_tree_strjoin(struct syntax_tree *t, const char *s0, const char *sep, const char *s1);
 
 struct syntax_chunk {
 	struct syntax_node n;
@@ -53,9 +74,11 @@ struct syntax_chunk {
 
 struct syntax_block {
 	struct syntax_node n;
-	struct symbol_table *symtab;
+	struct symbol_table *symtab;	/* NULL until the first symbol */
+	struct syntax_block *link;	/* next block in syntax_tree.blocks */
 };
 
+struct symbol_table *syntax_block_symbol_table(struct syntax_tree *t, struct syntax_block *b);
 struct symbol_table *syntax_node_symbol_table(struct syntax_node *n);
 struct symbol_table *syntax_node_parent_symbol_table(struct syntax_node *n);
 int chunk_scope(struct syntax_node *n);
@@ -148,10 +171,15 @@ struct syntax_expression {
 	struct syntax_node n;
 
 	enum syntax_expression_tag tag;
+	int isint;				/* EXP_NUMBER holds an integer */
 	union {
 		double number;
-		char *string;
+		char *string;		/* literals as written, numbers too */
 	} value;
+	union {
+		long long integer;
+		double number;
+	} num;					/* EXP_NUMBER value, converted by the lexer */
 };
 
 enum syntax_variable_tag {
@@ -163,22 +191,40 @@ enum syntax_variable_tag {
 
 const char *syntax_variable_tag_string(enum syntax_variable_tag tag);
 
+/* what a name refers to, filled in by the resolver (see resolve.c) */
+enum syntax_binding {
+	BIND_NONE,
+	BIND_LOCAL,			/* local of the enclosing function */
+	BIND_UPVALUE,		/* local of an outer function */
+	BIND_GLOBAL,
+};
+
+const char *syntax_binding_string(enum syntax_binding bind);
+
 struct syntax_variable {
 	struct syntax_node n;
 
 	enum syntax_variable_tag tag;
 	char *name;
+	enum syntax_binding bind;	/* VAR_NORMAL only */
+	int slot;					/* local index in the declaring function */
 };
 
 struct syntax_function {
 	struct syntax_node n;
 	char *name;
 	char *pars;
+	enum syntax_binding bind;	/* of a plain function name */
+	int slot;
+	int nrets;		/* most values one of its returns gives */
+	int direct;		/* local and only ever called by name */
+	int spread;		/* a return gives all values of ... or of an unknown call */
 };
 
 struct syntax_functioncall {
 	struct syntax_node n;
 	char *name;
+	struct syntax_function *callee;	/* local function called by name, else NULL */
 };
 
 enum syntax_argument_tag {
@@ -198,8 +244,12 @@ struct syntax_argument {
 	char *name;
 };
 
+#define TABLE_JSON_UNKNOWN (-2)
+#define TABLE_JSON_NONE (-1)
+
 struct syntax_table {
 	struct syntax_node n;
+	long json;		/* size as json when made only of literals, set by the translator */
 };
 
 enum syntax_field_tag {
@@ -218,34 +268,16 @@ struct syntax_field {
 	char *name;
 };
 
-struct syntax_chunk *create_syntax_chunk();
-void release_syntax_chunk(struct syntax_chunk *chunk);
-
-struct syntax_block *create_syntax_block();
-void release_syntax_block(struct syntax_block *block);
-
-struct syntax_statement *create_syntax_statement();
-void release_syntax_statement(struct syntax_statement *stmt);
-
-struct syntax_expression *create_syntax_expression();
-void release_syntax_expression(struct syntax_expression *exp);
-
-struct syntax_variable *create_syntax_variable();
-void release_syntax_variable(struct syntax_variable *var);
-
-struct syntax_function *create_syntax_function();
-void release_syntax_function(struct syntax_function *func);
-
-struct syntax_functioncall *create_syntax_functioncall();
-void release_syntax_functioncall(struct syntax_functioncall *fcall);
-
-struct syntax_argument *create_syntax_argument();
-void release_syntax_argument(struct syntax_argument *arg);
-
-struct syntax_table *create_syntax_table();
-void release_syntax_table(struct syntax_table *table);
-
-struct syntax_field *create_syntax_field();
-void release_syntax_field(struct syntax_field *field);
+struct syntax_chunk *create_syntax_chunk(struct syntax_tree *t);
+struct syntax_block *create_syntax_block(struct syntax_tree *t);
+struct syntax_statement *create_syntax_statement(struct syntax_tree *t);
+struct syntax_expression *create_syntax_expression(struct syntax_tree *t);
+struct syntax_expression *create_syntax_number(struct syntax_tree *t, const char *s, size_t l);
+struct syntax_variable *create_syntax_variable(struct syntax_tree *t);
+struct syntax_function *create_syntax_function(struct syntax_tree *t);
+struct syntax_functioncall *create_syntax_functioncall(struct syntax_tree *t);
+struct syntax_argument *create_syntax_argument(struct syntax_tree *t);
+struct syntax_table *create_syntax_table(struct syntax_tree *t);
+struct syntax_field *create_syntax_field(struct syntax_tree *t);
 
 #endif
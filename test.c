@@ -10,6 +10,9 @@ void handle_hmap(size_t key, void *value) {
 	printf("handle hmap node: %zu,%p\n", key, value);
 }
 
+void handle_hmap_clear(size_t key, void *value) {
+}
+
 int main(int argc, char **argv) {
 	struct list l;
 	list_init(&l);
@@ -35,12 +38,12 @@ int main(int argc, char **argv) {
 	printf("%d\n", hmap_insert(&m, HKEY_STR("asd"), HVALUE(18)));
 	printf("%d\n", hmap_insert(&m, HKEY_STR("12131"), HVALUE(24)));
 
-	int a,b,c;
+	size_t a = 0, b = 0, c = 0;
 	printf("%d\n", hmap_get(&m, HKEY_INT(0), HVALUE_PTR(a)));
 	printf("%d\n", hmap_get(&m, HKEY_STR("asd"), HVALUE_PTR(b)));
 	printf("%d\n", hmap_get(&m, HKEY_STR("12131"), HVALUE_PTR(c)));
 
-	printf("a=%d,b=%d,c=%d\n", a,b,c);
+	printf("a=%zu,b=%zu,c=%zu\n", a,b,c);
 
 	hmap_foreach(&m, handle_hmap);
 
@@ -52,9 +55,25 @@ int main(int argc, char **argv) {
 	printf("%d\n", hmap_get(&m, HKEY_STR("asd"), HVALUE_PTR(b)));
 	printf("%d\n", hmap_get(&m, HKEY_STR("12131"), HVALUE_PTR(c)));
 
-	printf("a=%d,b=%d,c=%d\n", a,b,c);
+	printf("a=%zu,b=%zu,c=%zu\n", a,b,c);
 
 	hmap_foreach(&m, handle_hmap);	
-	
+
+	//grow past the initial capacity and shrink back
+	for(size_t i = 0; i < 1000; i++) {
+		hmap_insert(&m, HKEY_INT(i), HVALUE(i));
+	}
+	printf("count=%zu,cap=%zu\n", m.count, m.cap);
+	size_t miss = 0;
+	for(size_t i = 0; i < 1000; i++) {
+		if(!hmap_get(&m, HKEY_INT(i), HVALUE_PTR(a)) || a != i) miss++;
+		if(i % 2) hmap_remove(&m, HKEY_INT(i), NULL);
+	}
+	for(size_t i = 0; i < 1000; i++) {
+		if(hmap_get(&m, HKEY_INT(i), NULL) != !(i % 2)) miss++;
+	}
+	printf("count=%zu,miss=%zu\n", m.count, miss);
+
+	hmap_clear(&m, handle_hmap_clear);
 	return 0;
 }
@@ -1,112 +1,334 @@
+#include <limits.h>
+#include <math.h>
+#include <ctype.h>
+
 #include "fox.h"
 #include "symbol.h"
 #include "syntax.h"
+#include "output.h"
+#include "source.h"
+#include "stats.h"
 #include "translator.h"
 
-int yylex(void);
-int yyparse(void);
+int yyparse(void *scanner, struct parse_context *ctx);
 
-void yyset_in(FILE *in);
-void yyset_out(FILE *out);
-void yyset_lineno(int lineno);
-void yyset_filename(const char *name);
-void yyset_debug(int debug);
+int yylex_init_extra(struct parse_context *ctx, void **scanner);
+int yylex_destroy(void *scanner);
+void yyset_out(FILE *out, void *scanner);
+void yyset_debug(int debug, void *scanner);
 
-extern struct syntax_tree *parse_tree;
-extern struct symbol_table *parse_table;
+struct yy_buffer_state;
+struct yy_buffer_state *yy_scan_bytes(const char *bytes, int len, void *scanner);
+struct yy_buffer_state *yy_scan_buffer(char *base, size_t size, void *scanner);
+void yy_delete_buffer(struct yy_buffer_state *b, void *scanner);
 
-int parse(const char *filename,
-		  struct syntax_tree **tree,
-		  struct symbol_table **table) {
-	FILE *fp = fopen(filename, "rb");
-	if(!fp) {
-		log_error("open file failed %s", filename);
-		return 0;
+static void *scanner_create(struct parse_context *ctx) {
+	void *scanner = NULL;
+	if(yylex_init_extra(ctx, &scanner)) {
+		log_error("create scanner failed %s", ctx->filename);
+		return NULL;
 	}
-
-	yyset_in(fp);
-	yyset_out(stdout);
-	yyset_filename(filename);
-	yyset_lineno(1);
+	yyset_out(stdout, scanner);
 #ifdef DEBUG
-	yyset_debug(1);
+	yyset_debug(1, scanner);
 #else
-	yyset_debug(0);
+	yyset_debug(0, scanner);
 #endif
+	return scanner;
+}
 
-	log_info("parse lua program start: %s", filename);
-	
-	parse_tree = syntax_tree_create();
-	parse_table = symbol_table_create();	
-	int val = yyparse();
-	fclose(fp);
+/* run the parser over an input already attached to scanner */
+static int parse_scanner(void *scanner,
+						 struct parse_context *ctx,
+						 struct syntax_tree **tree,
+						 struct symbol_table **table,
+						 bool symtables) {
+	log_info("parse lua program start: %s", ctx->filename);
+
+	ctx->tree = syntax_tree_create();
+	ctx->table = symbol_table_create();
+	struct fox_stats *stats = ctx->stats;
+	double t0 = stats ? stats_now() : 0;
+	double lex = stats ? stats->lex : 0;
+	int val = yyparse(scanner, ctx);
+	double t1 = stats ? stats_now() : 0;
+	if(stats) stats->parse += t1 - t0 - (stats->lex - lex);
 
 	if(val) {
-		log_error("parse lua program failed: %s", filename);
-		syntax_tree_release(parse_tree);
-		symbol_table_release(parse_table);
+		log_error("parse lua program failed: %s", ctx->filename);
+		syntax_tree_release(ctx->tree);
+		symbol_table_release(ctx->table);
 		return 0;
 	}
+	if(fox_options.fold) {
+		fold_chunk_constants(ctx->tree, (struct syntax_chunk *)ctx->tree->root);
+		double t2 = stats ? stats_now() : 0;
+		if(stats) stats->fold += t2 - t1;
+		t1 = t2;
+	}
+	if(symtables) {
+		gen_chunk_symtables(ctx->tree, (struct syntax_chunk *)ctx->tree->root);
+		if(stats) stats->symtab += stats_now() - t1;
+	}
 	
-	log_info("parse lua program succeed: %s", filename);
-	*tree = parse_tree;
-	*table = parse_table;
+	log_info("parse lua program succeed: %s", ctx->filename);
+	log_debug("syntax tree %s, nodes:%zu, bytes:%zu",
+			  ctx->filename,
+			  syntax_tree_node_count(ctx->tree),
+			  syntax_tree_bytes(ctx->tree));
+	*tree = ctx->tree;
+	*table = ctx->table;
 	return 1;
 }
 
+int parse(const char *filename,
+		  struct syntax_tree **tree,
+		  struct symbol_table **table) {
+	struct fox_source src;
+	if(!source_open(&src, filename)) {
+		return 0;
+	}
+	int val = parse_source(filename, &src, tree, table);
+	source_close(&src);
+	return val;
+}
+
+/* scan the loaded source in place, no copy into a flex buffer */
+static int parse_source_in_place(const char *name,
+								 struct fox_source *src,
+								 struct syntax_tree **tree,
+								 struct symbol_table **table,
+								 struct fox_stats *stats,
+								 bool symtables) {
+	struct parse_context ctx;
+	ctx.filename = name;
+	ctx.tree = NULL;
+	ctx.table = NULL;
+	ctx.stats = stats;
+
+	void *scanner = scanner_create(&ctx);
+	if(!scanner) return 0;
+	struct yy_buffer_state *b = yy_scan_buffer(src->data, src->len + 2, scanner);
+	if(!b) {
+		log_error("scan buffer failed %s", name);
+		yylex_destroy(scanner);
+		return 0;
+	}
+	int val = parse_scanner(scanner, &ctx, tree, table, symtables);
+	yy_delete_buffer(b, scanner);
+	yylex_destroy(scanner);
+	return val;
+}
+
+int parse_source(const char *name,
+				 struct fox_source *src,
+				 struct syntax_tree **tree,
+				 struct symbol_table **table) {
+	return parse_source_in_place(name, src, tree, table, NULL, TRUE);
+}
+
+/* parse_source, adding the lexer, parser and symbol table times to stats */
+int parse_source_stats(const char *name,
+					   struct fox_source *src,
+					   struct syntax_tree **tree,
+					   struct symbol_table **table,
+					   struct fox_stats *stats) {
+	return parse_source_in_place(name, src, tree, table, stats, TRUE);
+}
+
+/* syntax tree only, gen_chunk_symtables is left to the caller */
+int parse_tree(const char *name,
+			   struct fox_source *src,
+			   struct syntax_tree **tree,
+			   struct symbol_table **table) {
+	return parse_source_in_place(name, src, tree, table, NULL, FALSE);
+}
+
+int parse_buffer(const char *name,
+				 const char *src,
+				 size_t len,
+				 struct syntax_tree **tree,
+				 struct symbol_table **table) {
+	if(!src || len > INT_MAX) {
+		log_error("invalid source buffer %s", name);
+		return 0;
+	}
+
+	struct parse_context ctx;
+	ctx.filename = name;
+	ctx.tree = NULL;
+	ctx.table = NULL;
+	ctx.stats = NULL;
+
+	void *scanner = scanner_create(&ctx);
+	if(!scanner) return 0;
+	struct yy_buffer_state *b = yy_scan_bytes(src, (int)len, scanner);
+	if(!b) {
+		log_error("scan buffer failed %s", name);
+		yylex_destroy(scanner);
+		return 0;
+	}
+	int val = parse_scanner(scanner, &ctx, tree, table, TRUE);
+	yy_delete_buffer(b, scanner);
+	yylex_destroy(scanner);
+	return val;
+}
+
+struct json_frame;
+
 struct translator {
 	struct syntax_tree *tree;
 	struct symbol_table *table;
-	FILE *fp;
+	struct fox_output *out;
 	bool exp_symtab;
+	struct emit_item *items;	/* pending expression output, see emit_node */
+	size_t nitems;
+	size_t items_cap;
+	struct json_frame *frames;	/* open tables of the json passes */
+	size_t nframes;
+	size_t frames_cap;
 };
 
 static struct translator *translator_create(struct syntax_tree *tree,
 											struct symbol_table *table,
-											const char *filename) {
-	FILE *fp = fopen(filename, "wb");
-	if(!fp) {
-		log_error("open file failed %s", filename);
-		return NULL;
-	}
-
+											struct fox_output *out) {
 	struct translator *t = malloc(sizeof(struct translator));
 	t->tree = tree;
 	t->table = table;
-	t->fp = fp;
+	t->out = out;
 	t->exp_symtab = FALSE;
+	t->items = NULL;
+	t->nitems = 0;
+	t->items_cap = 0;
+	t->frames = NULL;
+	t->nframes = 0;
+	t->frames_cap = 0;
 	return t;
 }
 
 static void translator_release(struct translator *t) {
 	if(!t) return;
-
-	fclose(t->fp);
+	free(t->items);
+	free(t->frames);
 	free(t);
 }
 
 static int translate_syntax_node(struct translator *t, struct syntax_node *n);
 
-int translate(const char *filename,
-			  struct syntax_tree *tree,
-			  struct symbol_table *table) {
+/*
+ * --minify squeezes the js once it is written. spaces go unless they keep
+ * two tokens apart, line breaks end statements so they stay, except where
+ * no statement can end. string literals are copied as they are.
+ */
+static int minify_word(unsigned char c) {
+	return isalnum(c) || c == '_' || c == '$' || c >= 0x80;
+}
+
+/* a and b would read as one token */
+static int minify_glue(unsigned char a, unsigned char b) {
+	if(minify_word(a) && minify_word(b)) return 1;
+	return (a == '+' || a == '-' || a == '/') && a == b;
+}
+
+static int minify_keep_newline(char last, const char *next, const char *end) {
+	if(!last || strchr("{([,;:=", last)) return 0;
+	if(next == end || strchr("})],;", *next)) return 0;
+	//a block before else
+	if(last == '}' && end - next >= 4 && !strncmp(next, "else", 4)) {
+		return next + 4 < end && minify_word(next[4]);
+	}
+	return 1;
+}
+
+/* bytes the squeeze stops at, the rest is copied in runs */
+static const unsigned char minify_stop[256] = {
+	[' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1, ['"'] = 2, ['\''] = 2,
+};
+
+static void minify_output(struct fox_output *o, size_t start) {
+	char *d = o->data + start;
+	const char *s = d;
+	const char *end = o->data + o->len;
+	char last = 0;
+	while(s < end) {
+		char c = *s;
+		if(!minify_stop[(unsigned char)c]) {
+			*d++ = *s++;
+			last = c;
+			continue;
+		}
+		if(minify_stop[(unsigned char)c] == 2) {
+			//string literal, up to the closing quote
+			*d++ = *s++;
+			while(s < end && *s != c) {
+				if(*s == '\\' && s + 1 < end) *d++ = *s++;
+				*d++ = *s++;
+			}
+			if(s < end) *d++ = *s++;
+			last = c;
+			continue;
+		}
+		int newline = 0;
+		while(s < end && minify_stop[(unsigned char)*s] == 1) {
+			if(*s++ == '\n') newline = 1;
+		}
+		if(newline && minify_keep_newline(last, s, end)) {
+			*d++ = '\n';
+		} else if(last && s < end && minify_glue(last, *s)) {
+			*d++ = ' ';
+		}
+	}
+	o->len = d - o->data;
+}
+
+int translate_output(struct fox_output *out,
+					 struct syntax_tree *tree,
+					 struct symbol_table *table) {
+	return translate_output_runtime(out, tree, table, "./" FOX_RUNTIME);
+}
+
+int translate_output_runtime(struct fox_output *out,
+							 struct syntax_tree *tree,
+							 struct symbol_table *table,
+							 const char *runtime) {
 	if(!tree || !tree->root || !table) {
 		log_error("syntax tree or symbol table is invalid");
 		return 0;
 	}
-	
-	log_info("translate lua program start: %s", filename);
 
-	struct translator *t = translator_create(tree, table, filename);
+	struct translator *t = translator_create(tree, table, out);
 	if(!t) {
 		log_error("create translator failed");
 		return 0;
 	}
 
-	fprintf(t->fp, "//CODE GENERATED BY FOX, A LUA->JS TRANSLATOR!\n\n");
-	fflush(t->fp);
+	emit_str(t->out, "//CODE GENERATED BY FOX, A LUA->JS TRANSLATOR!\n\n");
+	size_t start = t->out->len;
+	emit_fmt(t->out, "const fox = require(\"%s\")\n", runtime);
+	if(tree->regs) {
+		emit_str(t->out, "let rtmp = {");
+		for(int i = 0; i < tree->regs; i++) emit_fmt(t->out, "%sv%d: nil", i ? ", " : "", i);
+		emit_str(t->out, "}\n");
+	}
 	int val = translate_syntax_node(t, tree->root);
+	if(val && fox_options.minify) minify_output(t->out, start);
 	translator_release(t);
+	return val;
+}
+
+int translate(const char *filename,
+			  struct syntax_tree *tree,
+			  struct symbol_table *table) {
+	log_info("translate lua program start: %s", filename);
+
+	struct fox_output out;
+	output_init(&out);
+	output_reserve(&out, OUTPUT_INIT_CAP);
+	int val = translate_output(&out, tree, table);
+	if(val) {
+		val = output_write_file(&out, filename);
+	}
+	output_release(&out);
 	if(!val) {
 		log_error("translate lua program failed:%s", filename);
 		return 0;
@@ -126,18 +348,15 @@ static int trans_syntax_functioncall(struct translator *t, struct syntax_node *n
 static int trans_syntax_argument(struct translator *t, struct syntax_node *n);
 static int trans_syntax_table(struct translator *t, struct syntax_node *n);
 static int trans_syntax_field(struct translator *t, struct syntax_node *n);
+static int emit_node(struct translator *t, struct syntax_node *n);
 
-static int func_is_method(const char *funcname) {
-	return funcname && strstr(funcname, ":");
-}
-
-static struct translator *translator = NULL;
+static __thread struct translator *translator = NULL;
 static void exports_handler(const char *name, struct symbol *s) {
 	if(translator) {
-		fprintf(translator->fp, name);
-		fprintf(translator->fp, ":");
-		fprintf(translator->fp, name);
-		fprintf(translator->fp, ",\n");
+		emit_str(translator->out, name);
+		emit_char(translator->out, ':');
+		emit_str(translator->out, name);
+		emit_str(translator->out, ",\n");
 	}
 }
 
@@ -156,14 +375,14 @@ static int trans_syntax_chunk(struct translator *t, struct syntax_node *n) {
 	int val = trans_syntax_block(t, n->children);
 	if(!val) return 0;
 
-	if(t->exp_symtab) {
+	if(t->exp_symtab && ((struct syntax_block *)n->children)->symtab) {
 		struct syntax_block *block = (struct syntax_block *)n->children;
-		fprintf(t->fp, "\n\nmodule.exports = {\n  ");
+		emit_str(t->out, "\n\nmodule.exports = {\n  ");
 		translator = t;
 		symbol_table_walk(block->symtab, exports_handler);
-		fseek(t->fp, -2, SEEK_END);
+		output_truncate(t->out, t->out->len - 2);
 		translator = NULL;
-		fprintf(t->fp, "\n}\n");
+		emit_str(t->out, "\n}\n");
 	}
 	return 1;
 }
@@ -172,17 +391,268 @@ static void log_block_symbols(const char *name, struct symbol *s) {
 	log_debug("block symbols %d:%s", ((struct syntax_node *)s->udata)->lineno, name);
 }
 
+/*
+ * functions with more than one return value come in two kinds. a direct
+ * one, a local only ever called by name, returns the first value and
+ * leaves the others in rtmp.v1... of the module, every exit writes all of
+ * them. any other returns an array from every exit. calls wanting one
+ * value take [0] of an array, calls wanting more read the register or
+ * destructure the array, so only the array kind allocates. a function
+ * returning ... or an unknown call as is gives its callers whatever that
+ * gives, like any unknown callee, or always an array past one value.
+ */
+enum call_conv {
+	CONV_UNKNOWN,	/* not a local function, an array or one bare value */
+	CONV_SINGLE,	/* gives one value */
+	CONV_ARRAY,
+	CONV_REGISTER,
+};
+
+static enum call_conv func_conv(struct syntax_function *func) {
+	//a return passes ... or an unknown call on as it comes
+	if(func && func->spread) return func->nrets > 1 ? CONV_ARRAY : CONV_UNKNOWN;
+	if(!func || func->nrets <= 1) return CONV_SINGLE;
+	return func->direct ? CONV_REGISTER : CONV_ARRAY;
+}
+
+static enum call_conv call_conv(struct syntax_functioncall *fcall) {
+	if(fcall->callee) return func_conv(fcall->callee);
+	return call_lib_single(fcall) ? CONV_SINGLE : CONV_UNKNOWN;
+}
+
+/* all values of a call as an array, an unknown callee may give a bare one */
+static int trans_call_array(struct translator *t, struct syntax_functioncall *fcall) {
+	if(call_conv(fcall) != CONV_UNKNOWN) return trans_syntax_functioncall(t, &fcall->n);
+	emit_str(t->out, "fox.values(");
+	if(!trans_syntax_functioncall(t, &fcall->n)) return 0;
+	emit_char(t->out, ')');
+	return 1;
+}
+
+/* values a call gives under its convention */
+static int call_nrets(struct syntax_functioncall *fcall) {
+	return fcall->callee && fcall->callee->nrets > 1 ? fcall->callee->nrets : 1;
+}
+
+/* the call an expression is, NULL for anything else */
+static struct syntax_functioncall *exp_call(struct syntax_node *n) {
+	if(!n || n->type != STX_EXPRESSION || ((struct syntax_expression *)n)->tag != EXP_FCALL) return NULL;
+	return (struct syntax_functioncall *)n->children;
+}
+
+static struct syntax_function *stmt_function(struct syntax_node *n) {
+	struct syntax_node *p = n->parent;
+	while(p && p->type != STX_FUNCTION) p = p->parent;
+	return (struct syntax_function *)p;
+}
+
+/* the sole value of a plain return, a call there passes all it gives */
+static int ret_passthrough(struct syntax_node *n) {
+	struct syntax_node *p = n->parent;
+	if(p->type != STX_STATEMENT || ((struct syntax_statement *)p)->tag != STMT_RETURN) return 0;
+	struct syntax_function *func = stmt_function(p);
+	return p->count == 1 && (!func || func->nrets <= 1);
+}
+
+static int exp_dots(struct syntax_node *n) {
+	return n && n->type == STX_EXPRESSION && ((struct syntax_expression *)n)->tag == EXP_DOTS;
+}
+
+/*
+ * ... is the rest parameter varargs of its function. the chunk is given
+ * none. it spreads all its values as the last argument, array item or
+ * return value, anywhere else it is the first one.
+ */
+static int dots_bound(struct syntax_node *n) {
+	struct syntax_function *func = stmt_function(n);
+	return func && func->pars && strstr(func->pars, "...");
+}
+
+/* the last argument or array item takes all values of a call or ... */
+static int list_spread(struct syntax_node *n) {
+	if(n->next) return 0;
+	struct syntax_node *p = n->parent;
+	if(p->type == STX_ARGUMENT) return 1;
+	return p->type == STX_FIELD && ((struct syntax_field *)p)->tag == FIELD_SINGLE && !p->next;
+}
+
+static int dots_spread(struct syntax_node *n) {
+	if(list_spread(n)) return 1;
+	struct syntax_node *p = n->parent;
+	return p->type == STX_STATEMENT && ((struct syntax_statement *)p)->tag == STMT_RETURN && stmt_function(p);
+}
+
+/* all values of ... as an array */
+static void emit_dots_array(struct translator *t, struct syntax_node *n) {
+	emit_str(t->out, dots_bound(n) ? "varargs" : "[]");
+}
+
+/* rtmp.v<from>..v<to-1> set to nil */
+static void emit_reg_fill(struct translator *t, int from, int to, const char *sep) {
+	for(int i = from; i < to; i++) emit_fmt(t->out, "rtmp.v%d = nil%s", i, sep);
+}
+
+/* a function whose last statement is no return still has to exit its way */
+static void trans_fall_off(struct translator *t, struct syntax_node *n) {
+	struct syntax_node *last = n->children;
+	while(last && last->next) last = last->next;
+	if(last && last->type == STX_STATEMENT && ((struct syntax_statement *)last)->tag == STMT_RETURN) return;
+	struct syntax_function *func = (struct syntax_function *)n->parent;
+	enum call_conv conv = func_conv(func);
+	if(conv == CONV_REGISTER) {
+		emit_char(t->out, '\n');
+		emit_reg_fill(t, 1, func->nrets, "\n");
+	} else if(conv == CONV_ARRAY) {
+		emit_str(t->out, "\nreturn []");
+	}
+}
+
+/* no calls inside, so it can be evaluated in any order */
+static int exp_pure(struct syntax_node *e) {
+	struct syntax_node *n = e;
+	while(n) {
+		if(n->type == STX_FUNCTIONCALL) return 0;
+		if(n->children && n->type != STX_FUNCTION) {
+			n = n->children;
+			continue;
+		}
+		while(n != e && !n->next) n = n->parent;
+		if(n == e) break;
+		n = n->next;
+	}
+	return 1;
+}
+
+/* a return inside a function with more values than one */
+static int trans_return_multi(struct translator *t, struct syntax_node *n, struct syntax_function *func) {
+	int nrets = func->nrets;
+	struct syntax_functioncall *tail = n->count == 1 ? exp_call(n->children) : NULL;
+	enum call_conv tconv = tail ? call_conv(tail) : CONV_SINGLE;
+	int k = tail ? call_nrets(tail) : 1;
+
+	if(func_conv(func) == CONV_ARRAY) {
+		if(tconv == CONV_ARRAY || tconv == CONV_UNKNOWN) {
+			emit_str(t->out, "return ");
+			return trans_call_array(t, tail);
+		}
+		emit_str(t->out, "return [");
+		if(tconv == CONV_REGISTER) {
+			if(!trans_syntax_functioncall(t, &tail->n)) return 0;
+			for(int i = 1; i < k; i++) emit_fmt(t->out, ", rtmp.v%d", i);
+		} else {
+			for(struct syntax_node *c = n->children; c; c = c->next) {
+				if(!trans_syntax_expression(t, c)) return 0;
+				if(c->next) emit_char(t->out, ',');
+			}
+		}
+		emit_char(t->out, ']');
+		return 1;
+	}
+
+	if(tconv == CONV_REGISTER && k == nrets) {
+		emit_str(t->out, "return ");
+		return trans_syntax_functioncall(t, &tail->n);
+	}
+	if(tconv == CONV_REGISTER || tconv == CONV_ARRAY) {
+		emit_str(t->out, "return (rtmp.v0 = ");
+		if(!trans_syntax_functioncall(t, &tail->n)) return 0;
+		if(tconv == CONV_REGISTER) {
+			emit_str(t->out, ", ");
+			emit_reg_fill(t, k, nrets, ", ");
+			emit_str(t->out, "rtmp.v0)");
+		} else {
+			for(int i = 1; i < nrets; i++) emit_fmt(t->out, ", rtmp.v%d = rtmp.v0[%d]", i, i);
+			emit_str(t->out, ", rtmp.v0[0])");
+		}
+		return 1;
+	}
+
+	//calls may use the register too, no slot is written before the last one
+	struct syntax_node *first = n->children;
+	bool pure = TRUE;
+	for(struct syntax_node *c = first ? first->next : NULL; c; c = c->next) {
+		if(!exp_pure(c)) pure = FALSE;
+	}
+	if(pure && first && !exp_pure(first)) {
+		emit_str(t->out, "return (rtmp.v0 = ");
+		if(!trans_syntax_expression(t, first)) return 0;
+		emit_str(t->out, ", ");
+		int i = 1;
+		for(struct syntax_node *c = first->next; c; c = c->next, i++) {
+			emit_fmt(t->out, "rtmp.v%d = ", i);
+			if(!trans_syntax_expression(t, c)) return 0;
+			emit_str(t->out, ", ");
+		}
+		emit_reg_fill(t, i, nrets, ", ");
+		emit_str(t->out, "rtmp.v0)");
+		return 1;
+	}
+	if(!pure) {
+		//their values wait in temps
+		emit_str(t->out, "{\nlet ");
+		int i = 0;
+		for(struct syntax_node *c = first; c; c = c->next, i++) {
+			emit_fmt(t->out, "%srtmp%d = ", i ? ", " : "", i);
+			if(!trans_syntax_expression(t, c)) return 0;
+		}
+		emit_str(t->out, "\nreturn (");
+		for(int j = 1; j < i; j++) emit_fmt(t->out, "rtmp.v%d = rtmp%d, ", j, j);
+		emit_reg_fill(t, i, nrets, ", ");
+		emit_str(t->out, "rtmp0)\n}");
+		return 1;
+	}
+
+	//no order to keep, the first value goes last
+	emit_str(t->out, "return (");
+	int i = 0;
+	for(struct syntax_node *c = first; c; c = c->next, i++) {
+		if(!i) continue;
+		emit_fmt(t->out, "rtmp.v%d = ", i);
+		if(!trans_syntax_expression(t, c)) return 0;
+		emit_str(t->out, ", ");
+	}
+	emit_reg_fill(t, i > 0 ? i : 1, nrets, ", ");
+	if(!first) {
+		emit_str(t->out, "nil)");
+	} else {
+		if(!trans_syntax_expression(t, first)) return 0;
+		emit_char(t->out, ')');
+	}
+	return 1;
+}
+
 static int trans_syntax_block(struct translator *t, struct syntax_node *n) {
 	log_debug("trans block %d", n->lineno);
 	struct syntax_block *block = (struct syntax_block *)n;
-	symbol_table_walk(block->symtab, log_block_symbols);
+	if(block->symtab) symbol_table_walk(block->symtab, log_block_symbols);
 
-	if(n->parent->type != STX_CHUNK) fprintf(t->fp, " {\n");
+	if(n->parent->type != STX_CHUNK) emit_str(t->out, " {\n");
 	int val = trans_syntax_node_children(t, n);
-	if(n->parent->type != STX_CHUNK) fprintf(t->fp, "\n}\n");
+	if(val && n->parent->type == STX_FUNCTION) trans_fall_off(t, n);
+	if(n->parent->type != STX_CHUNK) emit_str(t->out, "\n}\n");
 	return val;
 }
 
+/* next name of a comma separated list, *p moves past it */
+static size_t next_name(const char **p, const char **name) {
+	*name = *p;
+	while(**p != '\0' && **p != ',') (*p)++;
+	size_t l = *p - *name;
+	if(**p == ',') (*p)++;
+	return l;
+}
+
+/* calls past the values that are wanted still run */
+static int trans_extra_calls(struct translator *t, struct syntax_node *c) {
+	for(; c && c->type == STX_EXPRESSION; c = c->next) {
+		struct syntax_functioncall *fcall = exp_call(c);
+		if(!fcall) continue;
+		if(!trans_syntax_functioncall(t, &fcall->n)) return 0;
+		emit_char(t->out, '\n');
+	}
+	return 1;
+}
+
 static int trans_local_assign(struct translator *t, struct syntax_statement *stmt) {
 	if(stmt->tag != STMT_LOCAL_VAR) {
 		log_error("trans local assign with illeagal stmt %d:%s",
@@ -191,57 +661,100 @@ static int trans_local_assign(struct translator *t, struct syntax_statement *stm
 		return 0;
 	}
 	
-	int ncnt = 1;
-	char *p = stmt->value.name;
-	while(*p != '\0') {
-		if(*p++ == ',') ncnt++;
-	}
-
-	int ecnt = syntax_node_children_count(&stmt->n);
-	if(!ecnt) {
-		fprintf(t->fp, "let %s\n", stmt->value.name);
+	struct syntax_node *c = stmt->n.children;
+	if(!c) {
+		emit_str(t->out, "let ");
+		emit_str(t->out, stmt->value.name);
+		emit_str(t->out, "\n");
 		return 1;
 	}
 
-	if(ncnt == ecnt) {
-		if(ncnt == 1) {
-			fprintf(t->fp, "let %s = ", stmt->value.name);
-			int val = trans_syntax_expression(t, stmt->n.children);
-			if(!val) return 0;
-
-			fprintf(t->fp, "\n");
+	emit_str(t->out, "let ");
+	const char *p = stmt->value.name;
+	const char *name;
+	while(*p != '\0') {
+		size_t l = next_name(&p, &name);
+		if(!c) {
+			//no value left, nil
+			emit_strn(t->out, name, l);
+		} else if(*p != '\0' && !c->next && exp_dots(c)) {
+			emit_char(t->out, '[');
+			emit_strn(t->out, name, l);
+			emit_char(t->out, ',');
+			emit_str(t->out, p);
+			emit_str(t->out, "] = ");
+			emit_dots_array(t, c);
+			emit_char(t->out, '\n');
 			return 1;
-		} else {
-			fprintf(t->fp, "let %s = ", stmt->value.name);
-			char *p = stmt->value.name;
-			struct syntax_node *c = stmt->n.children;
-			while(c) {
-				while(*p != '\0' && *p != ',') {
-					fputc(*p, t->fp);
-					p++;
-				}
-				p++;
-			
-				fprintf(t->fp, " = ");
-				int val = trans_syntax_expression(t, c);
-				if(!val) return 0;
-				fprintf(t->fp, "\n");
-
-				c = c->next;
+		} else if(*p != '\0' && !c->next && exp_call(c)) {
+			//the last value is a call and gives the rest
+			struct syntax_functioncall *fcall = exp_call(c);
+			enum call_conv conv = call_conv(fcall);
+			if(conv == CONV_UNKNOWN || conv == CONV_ARRAY) {
+				emit_char(t->out, '[');
+				emit_strn(t->out, name, l);
+				emit_char(t->out, ',');
+				emit_str(t->out, p);
+				emit_str(t->out, "] = ");
+				if(!trans_call_array(t, fcall)) return 0;
+				emit_char(t->out, '\n');
+				return 1;
 			}
+			emit_strn(t->out, name, l);
+			emit_str(t->out, " = ");
+			if(!trans_syntax_functioncall(t, &fcall->n)) return 0;
+			int k = call_nrets(fcall);
+			for(int i = 1; *p != '\0'; i++) {
+				l = next_name(&p, &name);
+				emit_str(t->out, ", ");
+				emit_strn(t->out, name, l);
+				if(i < k) emit_fmt(t->out, " = rtmp.v%d", i);
+			}
+			emit_char(t->out, '\n');
+			return 1;
+		} else {
+			emit_strn(t->out, name, l);
+			emit_str(t->out, " = ");
+			if(!trans_syntax_expression(t, c)) return 0;
+			c = c->next;
 		}
-	} else if(ecnt == 1) {
-		fprintf(t->fp, "let %s = ", stmt->value.name);
-		int val = trans_syntax_expression(t, stmt->n.children);
-		if(!val) return 0;
+		if(*p != '\0') emit_str(t->out, ", ");
+	}
+	emit_char(t->out, '\n');
+	return trans_extra_calls(t, c);
+}
 
-		fprintf(t->fp, "\n");
+/* start of a store to a variable, the value and trans_store_end follow */
+static int trans_store(struct translator *t, struct syntax_node *n) {
+	struct syntax_variable *var = (struct syntax_variable *)n;
+	if(var->tag == VAR_NORMAL) {
+		emit_str(t->out, var->name);
+		emit_str(t->out, " = ");
 		return 1;
-	} else {
-		log_error("assign count mismatch %d:%d %d", stmt->n.lineno, ncnt, ecnt);
-		return 0;			
 	}
-	return 1;	
+	emit_str(t->out, "fox.setindex(");
+	if(!emit_node(t, n->children)) return 0;
+	if(var->tag == VAR_KEY) {
+		emit_fmt(t->out, ", \"%s\", ", var->name);
+		return 1;
+	}
+	emit_str(t->out, ", ");
+	if(!emit_node(t, n->children->next)) return 0;
+	emit_str(t->out, ", ");
+	return 1;
+}
+
+static void trans_store_end(struct translator *t, struct syntax_node *n) {
+	if(((struct syntax_variable *)n)->tag != VAR_NORMAL) emit_char(t->out, ')');
+	emit_char(t->out, '\n');
+}
+
+/* only names from nc on, no table is indexed */
+static int store_plain(struct syntax_node *nc) {
+	for(; nc && nc->type == STX_VARIABLE; nc = nc->next) {
+		if(((struct syntax_variable *)nc)->tag != VAR_NORMAL) return 0;
+	}
+	return 1;
 }
 
 static int trans_assign(struct translator *t, struct syntax_statement *stmt) {
@@ -252,66 +765,330 @@ static int trans_assign(struct translator *t, struct syntax_statement *stmt) {
 		return 0;
 	}
 
-	struct syntax_node *c = stmt->n.children;
-	int ncnt = 0;
-	struct syntax_node *nc = c;
-	while(c) {
-		if(c->type == STX_VARIABLE) {
-			ncnt++;
+	struct syntax_node *nc = stmt->n.children;
+	struct syntax_node *ec = nc;
+	while(ec && ec->type == STX_VARIABLE) ec = ec->next;
+	if(!ec || ec->type != STX_EXPRESSION) {
+		log_error("assign with no right value %d", stmt->n.lineno);
+		return 0;
+	}
+
+	while(nc && nc->type == STX_VARIABLE) {
+		struct syntax_functioncall *fcall = NULL;
+		bool dots = FALSE;
+		if(ec && nc->next && nc->next->type == STX_VARIABLE
+		   && (!ec->next || ec->next->type != STX_EXPRESSION)) {
+			fcall = exp_call(ec);
+			dots = exp_dots(ec);
+		}
+		enum call_conv conv = fcall ? call_conv(fcall) : CONV_SINGLE;
+
+		if(dots || (fcall && (conv == CONV_UNKNOWN || conv == CONV_ARRAY))) {
+			//the last value gives the rest as an array
+			bool plain = store_plain(nc);
+			emit_str(t->out, plain ? ";[" : "{\nlet rtmp0 = ");
+			if(!plain) {
+				if(dots) emit_dots_array(t, ec);
+				else if(!trans_call_array(t, fcall)) return 0;
+				emit_char(t->out, '\n');
+			}
+			for(int i = 0; nc && nc->type == STX_VARIABLE; nc = nc->next, i++) {
+				if(plain) {
+					if(!trans_syntax_variable(t, nc)) return 0;
+					if(nc->next && nc->next->type == STX_VARIABLE) emit_str(t->out, ", ");
+					continue;
+				}
+				if(!trans_store(t, nc)) return 0;
+				emit_fmt(t->out, "rtmp0[%d]", i);
+				trans_store_end(t, nc);
+			}
+			if(!plain) {
+				emit_str(t->out, "}\n");
+				return 1;
+			}
+			emit_str(t->out, "] = ");
+			if(dots) emit_dots_array(t, ec);
+			else if(!trans_call_array(t, fcall)) return 0;
+			emit_char(t->out, '\n');
+			return 1;
+		}
+		if(fcall) {
+			//a call in a target may use the register, copy it out first
+			bool plain = store_plain(nc->next);
+			int k = call_nrets(fcall);
+			if(!plain) {
+				emit_str(t->out, "{\nlet rtmp0 = ");
+				if(!trans_syntax_functioncall(t, &fcall->n)) return 0;
+				for(int i = 1; i < k; i++) emit_fmt(t->out, ", rtmp%d = rtmp.v%d", i, i);
+				emit_char(t->out, '\n');
+			}
+			for(int i = 0; nc && nc->type == STX_VARIABLE; nc = nc->next, i++) {
+				if(!trans_store(t, nc)) return 0;
+				if(!plain) {
+					if(i < k) emit_fmt(t->out, "rtmp%d", i);
+					else emit_str(t->out, "nil");
+				} else if(!i) {
+					if(!trans_syntax_functioncall(t, &fcall->n)) return 0;
+				} else if(i < k) {
+					emit_fmt(t->out, "rtmp.v%d", i);
+				} else {
+					emit_str(t->out, "nil");
+				}
+				trans_store_end(t, nc);
+			}
+			if(!plain) emit_str(t->out, "}\n");
+			return 1;
+		}
+
+		if(!trans_store(t, nc)) return 0;
+		if(ec && ec->type == STX_EXPRESSION) {
+			if(!trans_syntax_expression(t, ec)) return 0;
+			ec = ec->next;
 		} else {
-			break;
+			//no value left, nil
+			emit_str(t->out, "nil");
 		}
-		c = c->next;
+		trans_store_end(t, nc);
+		nc = nc->next;
 	}
-	int ecnt = 0;
-	struct syntax_node *ec = c;
-	while(c) {
-		if(c->type == STX_EXPRESSION) {
-			ecnt++;
-		} else {
-			break;
+	return trans_extra_calls(t, ec);
+}
+
+/* sign of a literal for step, 1 when there is none, 0 if unknown or zero */
+static int for_step_sign(struct syntax_node *sn) {
+	if(sn->type != STX_EXPRESSION) return 1;
+	struct syntax_expression *exp = (struct syntax_expression *)sn;
+	int sign = 1;
+	if(exp->tag == EXP_NEG) {
+		exp = (struct syntax_expression *)sn->children;
+		sign = -1;
+	}
+	if(exp->tag != EXP_NUMBER) return 0;
+	if(exp->isint) {
+		return exp->num.integer > 0 ? sign : exp->num.integer < 0 ? -sign : 0;
+	}
+	return exp->num.number > 0 ? sign : exp->num.number < 0 ? -sign : 0;
+}
+
+static int for_literal(struct syntax_node *n) {
+	struct syntax_expression *exp = (struct syntax_expression *)n;
+	if(exp->tag == EXP_NEG) exp = (struct syntax_expression *)n->children;
+	return exp->tag == EXP_NUMBER;
+}
+
+/* the body assigns the control variable, or a local of the same name */
+static int for_assigns(struct syntax_node *block, const char *name) {
+	struct syntax_node *n = block;
+	while(n) {
+		if(n->type == STX_STATEMENT && ((struct syntax_statement *)n)->tag == STMT_VAR) {
+			for(struct syntax_node *c = n->children; c && c->type == STX_VARIABLE; c = c->next) {
+				struct syntax_variable *var = (struct syntax_variable *)c;
+				if(var->tag == VAR_NORMAL && var->name == name) return 1;
+			}
 		}
-		c = c->next;
+		if(n->children) {
+			n = n->children;
+			continue;
+		}
+		while(n != block && !n->next) n = n->parent;
+		if(n == block) break;
+		n = n->next;
 	}
-	if(!ecnt) {
-		log_error("assign with no right value %d", stmt->n.lineno);
+	return 0;
+}
+
+/* the expression reads a variable of that name */
+static int exp_mentions(struct syntax_node *e, const char *name) {
+	struct syntax_node *n = e;
+	while(n) {
+		if(n->type == STX_VARIABLE && ((struct syntax_variable *)n)->tag == VAR_NORMAL &&
+		   !strcmp(((struct syntax_variable *)n)->name, name)) return 1;
+		if(n->children) {
+			n = n->children;
+			continue;
+		}
+		while(n != e && !n->next) n = n->parent;
+		if(n == e) break;
+		n = n->next;
+	}
+	return 0;
+}
+
+/*
+ * a counted loop when the step sign is known, the limit is read once.
+ * the for header is in the scope of its let, start and limit naming the
+ * control variable mean the outer one and are read before it.
+ */
+static int trans_for_counted(struct translator *t, struct syntax_statement *stmt,
+							 struct syntax_node *block, int sign) {
+	struct syntax_node *vn = stmt->n.children;
+	struct syntax_node *ln = vn->next;
+	struct syntax_node *sn = ln->next;
+	const char *name = stmt->value.name;
+	bool hoist = !for_literal(ln);
+	bool outer = exp_mentions(vn, name) || exp_mentions(ln, name);
+
+	if(outer) {
+		emit_str(t->out, "\n{\nlet value = ");
+		if(!trans_syntax_expression(t, vn)) return 0;
+		emit_str(t->out, ", limit = ");
+		if(!trans_syntax_expression(t, ln)) return 0;
+		emit_fmt(t->out, "\nfor(let %s = value", name);
+		hoist = TRUE;
+	} else {
+		emit_str(t->out, "\nfor(let ");
+		emit_str(t->out, name);
+		emit_str(t->out, " = ");
+		if(!trans_syntax_expression(t, vn)) return 0;
+		if(hoist) {
+			emit_str(t->out, ", limit = ");
+			if(!trans_syntax_expression(t, ln)) return 0;
+		}
+	}
+	emit_str(t->out, "; ");
+	emit_str(t->out, name);
+	emit_str(t->out, sign > 0 ? " <= " : " >= ");
+	if(hoist) {
+		emit_str(t->out, "limit");
+	} else if(!trans_syntax_expression(t, ln)) {
 		return 0;
 	}
+	emit_str(t->out, "; ");
+	emit_str(t->out, name);
+	if(sn->type == STX_EXPRESSION) {
+		emit_str(t->out, " += ");
+		if(!trans_syntax_expression(t, sn)) return 0;
+	} else {
+		emit_str(t->out, "++");
+	}
+	emit_char(t->out, ')');
+	if(!trans_syntax_block(t, block)) return 0;
+	if(outer) emit_str(t->out, "}\n");
+	return 1;
+}
 
-	if(ncnt == ecnt) {
-		while(nc && nc->type == STX_VARIABLE) {
-			int val = trans_syntax_variable(t, nc);
-			if(!val) return 0;
-			fprintf(t->fp, " = ");
-			
-			val = trans_syntax_expression(t, ec);
-			if(!val) return 0;
-			fprintf(t->fp, "\n");
-			
-			nc = nc->next;
-			ec = ec->next;
+enum for_iterator {
+	ITER_UNKNOWN,
+	ITER_NEXT,		/* next, t */
+	ITER_PAIRS,		/* pairs(t), which may be __pairs */
+	ITER_IPAIRS,	/* ipairs(t) */
+};
+
+/* the global of that name, not a local hiding it */
+static int for_global(struct syntax_node *n, const char *name) {
+	struct syntax_expression *exp = (struct syntax_expression *)n;
+	if(n->type != STX_EXPRESSION || exp->tag != EXP_VAR) return 0;
+	struct syntax_variable *var = (struct syntax_variable *)n->children;
+	return var->tag == VAR_NORMAL && var->bind == BIND_GLOBAL && !strcmp(var->name, name);
+}
+
+/* a stock iterator known at translate time, *tn is the table it walks */
+static enum for_iterator for_in_iterator(struct syntax_node *e, struct syntax_node **tn) {
+	struct syntax_node *next = e->next;
+	if(next && next->type == STX_EXPRESSION) {
+		//next, t [, nil]
+		struct syntax_node *init = next->next;
+		if(!for_global(e, "next")) return ITER_UNKNOWN;
+		if(init && init->type == STX_EXPRESSION
+		   && ((struct syntax_expression *)init)->tag != EXP_NIL) return ITER_UNKNOWN;
+		*tn = next;
+		return ITER_NEXT;
+	}
+
+	if(((struct syntax_expression *)e)->tag != EXP_FCALL) return ITER_UNKNOWN;
+	struct syntax_functioncall *fcall = (struct syntax_functioncall *)e->children;
+	struct syntax_argument *arg = (struct syntax_argument *)fcall->n.children->next;
+	if(fcall->name || arg->tag != ARG_NORMAL || arg->n.count != 1) return ITER_UNKNOWN;
+	*tn = arg->n.children;
+	if(for_global(fcall->n.children, "pairs")) return ITER_PAIRS;
+	if(for_global(fcall->n.children, "ipairs")) return ITER_IPAIRS;
+	return ITER_UNKNOWN;
+}
+
+/*
+ * pairs and next step a cursor of the runtime over the array and hash
+ * parts, only slots holding a value come up. ipairs counts up from 1 to
+ * the first nil. nothing is allocated per iteration. a table with
+ * __pairs is walked by its own iterator, checked once before the loop.
+ */
+static int trans_for_in_native(struct translator *t, struct syntax_statement *stmt,
+							   struct syntax_node *block, struct syntax_node *tn,
+							   enum for_iterator iter) {
+	emit_str(t->out, iter != ITER_IPAIRS ? "\n{\nlet stmp = fox.walk(" : "\n{\nlet stmp = ");
+	if(!trans_syntax_expression(t, tn)) return 0;
+	emit_str(t->out, iter != ITER_IPAIRS ? ")\n" : "\n");
+
+	const char *key = stmt->value.name;
+	const char *e = key;
+	while(*e != ',' && *e != '\0') e++;
+	size_t kl = e - key;
+	const char *value = *e ? e + 1 : NULL;
+	const char *ve = value;
+	while(ve && *ve != ',' && *ve != '\0') ve++;
+
+	if(iter == ITER_PAIRS) {
+		//ftmp is the __pairs iterator, null for a plain table
+		emit_str(t->out, "let ftmp = fox.custom(stmp)\n"
+				 "for(let vtmp = ftmp === null ? fox.step(stmp, -1) : fox.pstep(ftmp); vtmp !== -1; "
+				 "vtmp = ftmp === null ? fox.step(stmp, vtmp) : fox.pstep(ftmp)) {\nlet ");
+		emit_strn(t->out, key, kl);
+		emit_str(t->out, " = ftmp === null ? fox.key(stmp, vtmp) : ftmp.k\n");
+		if(value) {
+			emit_str(t->out, "let ");
+			emit_strn(t->out, value, ve - value);
+			emit_str(t->out, " = ftmp === null ? fox.value(stmp, vtmp) : ftmp.v\n");
 		}
-	} else if(ecnt == 1) {
-		fprintf(t->fp, "{");
-		while(nc && nc->type == STX_VARIABLE) {
-			int val = trans_syntax_variable(t, nc);
-			if(!val) return 0;
-			if(nc->next && nc->next->type == STX_VARIABLE) {
-				fprintf(t->fp, ", ");				
-			}
-			nc = nc->next;
+	} else if(iter == ITER_NEXT) {
+		emit_str(t->out, "for(let vtmp = fox.step(stmp, -1); vtmp !== -1; vtmp = fox.step(stmp, vtmp)) {\nlet ");
+		emit_strn(t->out, key, kl);
+		emit_str(t->out, " = fox.key(stmp, vtmp)\n");
+		if(value) {
+			emit_str(t->out, "let ");
+			emit_strn(t->out, value, ve - value);
+			emit_str(t->out, " = fox.value(stmp, vtmp)\n");
 		}
-		fprintf(t->fp, "}");
-		fprintf(t->fp, " = ");
-		int val = trans_syntax_expression(t, ec);
-		if(!val) return 0;
-		fprintf(t->fp, "\n");
-		return 1;
 	} else {
-		log_error("assign count mismatch %d:%d %d", stmt->n.lineno, ncnt, ecnt);
-		return 0;			
+		//the body may assign the key, count on a copy then
+		const char *k = strpool_find(&t->tree->strings, key, kl);
+		emit_str(t->out, "for(let ");
+		if(k && for_assigns(block, k)) {
+			emit_str(t->out, "vtmp = 1; ; vtmp++) {\nlet ");
+			emit_strn(t->out, key, kl);
+			emit_str(t->out, " = vtmp\n");
+		} else {
+			emit_strn(t->out, key, kl);
+			emit_str(t->out, " = 1; ; ");
+			emit_strn(t->out, key, kl);
+			emit_str(t->out, "++) {\n");
+		}
+		if(value) {
+			emit_str(t->out, "let ");
+			emit_strn(t->out, value, ve - value);
+			emit_str(t->out, " = fox.index(stmp, ");
+			emit_strn(t->out, key, kl);
+			emit_str(t->out, ")\nif(");
+			emit_strn(t->out, value, ve - value);
+			emit_str(t->out, " == null) break\n");
+		} else {
+			emit_str(t->out, "if(fox.index(stmp, ");
+			emit_strn(t->out, key, kl);
+			emit_str(t->out, ") == null) break\n");
+		}
+	}
+	//names past the value are always nil
+	const char *p = ve;
+	while(p && *p == ',') {
+		const char *q = ++p;
+		while(*p != ',' && *p != '\0') p++;
+		emit_str(t->out, "let ");
+		emit_strn(t->out, q, p - q);
+		emit_char(t->out, '\n');
 	}
-	return 1;	
+
+	if(!trans_syntax_block(t, block)) return 0;
+	emit_str(t->out, "}\n"); //for
+	emit_str(t->out, "}\n"); //block
+	return 1;
 }
 
 static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
@@ -325,51 +1102,61 @@ static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
 		return 1;
 	case STMT_LABEL:
 	{
-		fprintf(t->fp, "%s:\n", stmt->value.name);
+		emit_str(t->out, stmt->value.name);
+		emit_str(t->out, ":\n");
 		return 1;
 	}
 	case STMT_GOTO:
 	{
 		//we support continue label not break label
-		fprintf(t->fp, "continue %s", stmt->value.name);
+		emit_str(t->out, "continue ");
+		emit_str(t->out, stmt->value.name);
 		return 1;
 	}
 	case STMT_BREAK:
 	{
 
-		fprintf(t->fp, "break");
+		emit_str(t->out, "break");
 		return 1;
 	}
 	case STMT_RETURN:
 	{
 		if(!n->children) {
-			if(chunk_scope(n)) {
+			struct syntax_function *func = stmt_function(n);
+			if(func && func->nrets > 1) {
+				return trans_return_multi(t, n, func);
+			} else if(chunk_scope(n)) {
 				return 1;
 			} else {
-				fprintf(t->fp, "return");
+				emit_str(t->out, "return");
 				return 1;
 			}
 		}
 		
+		struct syntax_function *func = stmt_function(n);
+		if(func && func->nrets > 1) {
+			return trans_return_multi(t, n, func);
+		}
+
 		if(chunk_scope(n)) {
-			fprintf(t->fp, "\n\nmodule.exports = ");
+			emit_str(t->out, "\n\nmodule.exports = ");
 			t->exp_symtab = FALSE;
 		} else {
-			fprintf(t->fp, "return ");
+			emit_str(t->out, "return ");
 		}
 
 		if(syntax_node_children_count(n) > 1) {
-			fprintf(t->fp, "[");
+			emit_char(t->out, '[');
 		}
 		struct syntax_node *c = n->children;
 		while(c) {
 			int val = trans_syntax_expression(t, c);
 			if(!val) return 0;
-			if(c->next) fprintf(t->fp, ",");
+			if(c->next) emit_char(t->out, ',');
 			c = c->next;
 		}
 		if(syntax_node_children_count(n) > 1) {
-			fprintf(t->fp, "]");
+			emit_char(t->out, ']');
 		}
 		return 1;
 	}
@@ -379,85 +1166,83 @@ static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
 	}
 	case STMT_WHILE:
 	{
-		fprintf(t->fp, "while (");
+		emit_str(t->out, "while (");
 		int val = trans_syntax_expression(t, n->children);
 		if(!val) return 0;
-		fprintf(t->fp, ")");
+		emit_char(t->out, ')');
 		return trans_syntax_block(t, n->children->next);
 	}
 	case STMT_REPEAT:
 	{
-		fprintf(t->fp, "do ");
+		emit_str(t->out, "do ");
 		int val = trans_syntax_block(t, n->children);
 		if(!val) return 0;
-		fprintf(t->fp, "while (");
+		emit_str(t->out, "while (");
 		val = trans_syntax_expression(t, n->children->next);
 		if(!val) return 0;
-		fprintf(t->fp, ")\n");
+		emit_str(t->out, ")\n");
 		return 1;
 	}
 	case STMT_FOR_IN:
 	{
-		fprintf(t->fp, "\n{\n");
+		struct syntax_node *tn = NULL;
+		enum for_iterator iter = for_in_iterator(n->children, &tn);
+		if(iter != ITER_UNKNOWN) {
+			struct syntax_node *block = n->children;
+			while(block && block->type != STX_BLOCK) block = block->next;
+			if(block) return trans_for_in_native(t, stmt, block, tn, iter);
+		}
+
+		emit_str(t->out, "\n{\n");
 
-		bool needvtmp = TRUE;
 		struct syntax_node *e = n->children;
-		if(((struct syntax_expression *)e)->tag == EXP_FCALL && syntax_node_sibling_count(e) == 1) {
-			fprintf(t->fp, "let retvals = ");
-			int val = trans_syntax_expression(t, e);
+		struct syntax_functioncall *fcall = syntax_node_sibling_count(e) == 1 ? exp_call(e) : NULL;
+		enum call_conv conv = fcall ? call_conv(fcall) : CONV_UNKNOWN;
+		if(conv == CONV_REGISTER || conv == CONV_SINGLE) {
+			emit_str(t->out, "let ftmp = ");
+			if(!trans_syntax_functioncall(t, &fcall->n)) return 0;
+			int k = call_nrets(fcall);
+			emit_str(t->out, k > 1 ? "\nlet stmp = rtmp.v1\n" : "\nlet stmp = nil\n");
+			emit_str(t->out, k > 2 ? "let vtmp = rtmp.v2\n" : "let vtmp = nil\n");
+		} else if(fcall) {
+			emit_str(t->out, "let retvals = ");
+			int val = trans_call_array(t, fcall);
 			if(!val) return 0;
-			fprintf(t->fp, "\n");
+			emit_char(t->out, '\n');
 			
-			fprintf(t->fp, "let ftmp = retvals[0]\n");
-			fprintf(t->fp, "let stmp = retvals[1]\n");
-			fprintf(t->fp, "let vtmp = retvals[2]\n");
+			emit_str(t->out, "let ftmp = retvals[0]\n");
+			emit_str(t->out, "let stmp = retvals[1]\n");
+			emit_str(t->out, "let vtmp = retvals[2]\n");
 		} else {
-			fprintf(t->fp, "let ftmp = ");
-			int val = trans_syntax_expression(t, e);
-			if(!val) return 0;
-			fprintf(t->fp, "\n");
-
-			e = e->next;
-			if(!e || e->type != STX_EXPRESSION) {
-				log_error("missing exp for in stmt %d:%s",
-						  n->lineno,
-						  syntax_expression_tag_string(stmt->tag));
-				return 0;
-			}
-			fprintf(t->fp, "let stmp = ");
-			val = trans_syntax_expression(t, e);
-			if(!val) return 0;
-			fprintf(t->fp, "\n");
-
-			e = e->next;
-			if(e && e->type == STX_EXPRESSION) {
-				fprintf(t->fp, "let vtmp = ");
-				val = trans_syntax_expression(t, e);
-				if(!val) return 0;
-				fprintf(t->fp, "\n");
-			} else {
-				needvtmp = FALSE;
+			//missing state and control values are nil
+			static const char *const decls[] = {"let ftmp = ", "let stmp = ", "let vtmp = "};
+			for(int i = 0; i < 3; i++) {
+				emit_str(t->out, decls[i]);
+				if(e && e->type == STX_EXPRESSION) {
+					if(!trans_syntax_expression(t, e)) return 0;
+					e = e->next;
+				} else {
+					emit_str(t->out, "nil");
+				}
+				emit_char(t->out, '\n');
 			}
 		}
 
-		fprintf(t->fp, "while(true) {\n");
-		if(needvtmp)
-			fprintf(t->fp, "let vs = ftmp(stmp, vtmp)\n");
-		else
-			fprintf(t->fp, "let vs = ftmp(stmp)\n");
-		fprintf(t->fp, "if(vs[0] == null) break\n");
-		if(needvtmp)
-			fprintf(t->fp, "vtmp = vs[0]\n");
+		//the control value is passed back on every step, the others are parked
+		emit_str(t->out, "while(true) {\n");
+		emit_str(t->out, "vtmp = fox.take(ftmp(stmp, vtmp))\n");
+		emit_str(t->out, "if(vtmp == null) break\n");
 
 		int idx = 0;
 		char *p = stmt->value.name;
 		while(*p != '\0') {
-			fprintf(t->fp, "let ");
+			emit_str(t->out, "let ");
 			while(*p != '\0' && *p != ',') {
-				fputc(*p, t->fp);
+				emit_char(t->out, *p);
 				p++;
 			}
-			fprintf(t->fp, " = vs[%d]\n", idx);
+			if(idx) emit_fmt(t->out, " = fox.rest(%d)\n", idx);
+			else emit_str(t->out, " = vtmp\n");
 			if(*p != '\0') {
 				p++;
 				idx++;
@@ -475,46 +1260,52 @@ static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
 					  syntax_statement_tag_string(stmt->tag));
 			return 0;
 		}
-		fprintf(t->fp, "}\n"); //while
-		fprintf(t->fp, "}\n"); //for
+		emit_str(t->out, "}\n"); //while
+		emit_str(t->out, "}\n"); //for
 		return 1;
 	}
 	case STMT_FOR_IT:
 	{
-		fprintf(t->fp, "\n{\n");
+		struct syntax_node *block = n->children;
+		while(block && block->type != STX_BLOCK) block = block->next;
+		int sign = for_step_sign(n->children->next->next);
+		if(block && sign && !for_assigns(block, stmt->value.name)) {
+			return trans_for_counted(t, stmt, block, sign);
+		}
+
+		//step sign known only at run time
+		emit_str(t->out, "\n{\n");
 
 		struct syntax_node *vn = n->children;
-		fprintf(t->fp, "let value = ");
+		emit_str(t->out, "let value = ");
 		int val = trans_syntax_expression(t, vn);
 		if(!val) return 0;
-		fprintf(t->fp, "\n");
+		emit_char(t->out, '\n');
 
 		struct syntax_node *ln = vn->next;
-		fprintf(t->fp, "let limit = ");
+		emit_str(t->out, "let limit = ");
 		val = trans_syntax_expression(t, ln);
 		if(!val) return 0;
-		fprintf(t->fp, "\n");
+		emit_char(t->out, '\n');
 
 		struct syntax_node *sn = ln->next;
 		if(sn->type == STX_EXPRESSION) {
-			fprintf(t->fp, "let step = ");
+			emit_str(t->out, "let step = ");
 			int val = trans_syntax_expression(t, sn);
 			if(!val) return 0;
-			fprintf(t->fp, "\n");			
+			emit_char(t->out, '\n');			
 		} else {
-			fprintf(t->fp, "let step = 1\n");
+			emit_str(t->out, "let step = 1\n");
 		}
-		fprintf(t->fp, "value = value - step\n");
-		fprintf(t->fp, "while(true) {\n");
-		fprintf(t->fp, "value = value + step\n");
-		fprintf(t->fp, "if(step >= 0 && value > limit) break\n");
-		fprintf(t->fp, "if(step < 0 && value < limit) break\n");
+		emit_str(t->out, "value = value - step\n");
+		emit_str(t->out, "while(true) {\n");
+		emit_str(t->out, "value = value + step\n");
+		emit_str(t->out, "if(step >= 0 && value > limit) break\n");
+		emit_str(t->out, "if(step < 0 && value < limit) break\n");
 		
-		fprintf(t->fp, "let ");
-		fprintf(t->fp, stmt->value.name);
-		fprintf(t->fp, " = value\n");
-		struct syntax_node *block = n->children;
-		while(block && block->type != STX_BLOCK) block = block->next;
+		emit_str(t->out, "let ");
+		emit_str(t->out, stmt->value.name);
+		emit_str(t->out, " = value\n");
 		if(block) {
 			int val = trans_syntax_block(t, block);
 			if(!val) return 0;
@@ -524,16 +1315,16 @@ static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
 					  syntax_statement_tag_string(stmt->tag));
 			return 0;
 		}
-		fprintf(t->fp, "}\n"); //while stmt
-		fprintf(t->fp, "}\n"); //for stmt
+		emit_str(t->out, "}\n"); //while stmt
+		emit_str(t->out, "}\n"); //for stmt
 		return 1;
 	}
 	case STMT_IF:
 	{
-		fprintf(t->fp, "if(");
+		emit_str(t->out, "if(");
 		int val = trans_syntax_expression(t, n->children);
 		if(!val) return 0;
-		fprintf(t->fp, ")");
+		emit_char(t->out, ')');
 		val = trans_syntax_block(t, n->children->next);
 		if(!val) return 0;
 		val = trans_syntax_statement(t, n->children->next->next);
@@ -543,15 +1334,15 @@ static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
 	}
 	case STMT_ELSE:
 	{
-		fprintf(t->fp, "else");
+		emit_str(t->out, "else");
 		return trans_syntax_block(t, n->children);
 	}
 	case STMT_ELSEIF:
 	{
-		fprintf(t->fp, "else if(");
+		emit_str(t->out, "else if(");
 		int val = trans_syntax_expression(t, n->children);
 		if(!val) return 0;
-		fprintf(t->fp, ")");
+		emit_char(t->out, ')');
 		val = trans_syntax_block(t, n->children->next);
 		if(!val) return 0;
 		val = trans_syntax_statement(t, n->children->next->next);
@@ -593,7 +1384,7 @@ static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
 			return 0;
 		}
 		int val = trans_syntax_functioncall(t, c->children);
-		fprintf(t->fp, "\n");
+		emit_char(t->out, '\n');
 		return val;
 	}
 	default:
@@ -603,11 +1394,187 @@ static int trans_syntax_statement(struct translator *t, struct syntax_node *n) {
 				   syntax_statement_tag_string(stmt->tag));
 		return 0;
 	}
+}
+
+/*
+ * expressions are emitted from an explicit stack of pending work, either
+ * a node still to expand or a string to write, so long operator chains
+ * and nested tables grow the heap instead of the C stack. when a node is
+ * expanded everything before it is already written, its leading text
+ * goes out at once and the rest is queued last to first.
+ */
+struct emit_item {
+	struct syntax_node *n;
+	const char *s;
+};
+
+static inline void emit_reserve(struct translator *t, size_t k) {
+	if(t->nitems + k <= t->items_cap) return;
+	while(t->nitems + k > t->items_cap) {
+		t->items_cap = t->items_cap ? t->items_cap * 2 : 64;
+	}
+	t->items = realloc(t->items, t->items_cap * sizeof(struct emit_item));
+}
+
+static inline void emit_push(struct translator *t, struct syntax_node *n, const char *s) {
+	emit_reserve(t, 1);
+	t->items[t->nitems].n = n;
+	t->items[t->nitems].s = s;
+	t->nitems++;
+}
+
+/* literals and plain names are queued as their text */
+static inline const char *emit_leaf(struct syntax_node *n) {
+	if(n->type != STX_EXPRESSION) return NULL;
+	struct syntax_expression *exp = (struct syntax_expression *)n;
+	if(exp->tag == EXP_NUMBER || exp->tag == EXP_STRING) return exp->value.string;
+	if(exp->tag == EXP_VAR) {
+		struct syntax_variable *var = (struct syntax_variable *)n->children;
+		if(var->tag == VAR_NORMAL) return var->name;
+	}
+	return NULL;
+}
+
+static inline void emit_push_node(struct translator *t, struct syntax_node *n) {
+	const char *s = emit_leaf(n);
+	emit_push(t, s ? NULL : n, s);
+}
+
+static inline void emit_push_str(struct translator *t, const char *s) {
+	emit_push(t, NULL, s);
+}
+
+/* queue the children of n with sep between them */
+/* the fields of a table which are, or are not, positional */
+static void emit_push_fields(struct translator *t, struct syntax_node *n, bool single, const char *sep) {
+	size_t count = 0;
+	for(struct syntax_node *c = n->children; c; c = c->next) {
+		if((((struct syntax_field *)c)->tag == FIELD_SINGLE) == single) count++;
+	}
+	if(!count) return;
+	size_t k = 2 * count - 1;
+	emit_reserve(t, k);
+	struct emit_item *it = t->items + t->nitems + k;
+	t->nitems += k;
+	for(struct syntax_node *c = n->children; c; c = c->next) {
+		if((((struct syntax_field *)c)->tag == FIELD_SINGLE) != single) continue;
+		if(it != t->items + t->nitems) {
+			--it;
+			it->n = NULL;
+			it->s = sep;
+		}
+		--it;
+		it->n = c;
+		it->s = NULL;
+	}
+}
+
+static void emit_push_children(struct translator *t, struct syntax_node *n, const char *sep) {
+	size_t k = n->count ? 2 * n->count - 1 : 0;
+	emit_reserve(t, k);
+	struct emit_item *it = t->items + t->nitems + k;
+	t->nitems += k;
+	for(struct syntax_node *c = n->children; c; c = c->next) {
+		--it;
+		it->n = c;
+		it->s = NULL;
+		if(c->next) {
+			--it;
+			it->n = NULL;
+			it->s = sep;
+		}
+	}
+}
+
+static int expand_expression(struct translator *t, struct syntax_node *n);
+static int expand_variable(struct translator *t, struct syntax_node *n);
+static int expand_functioncall(struct translator *t, struct syntax_node *n);
+static int expand_argument(struct translator *t, struct syntax_node *n);
+static int expand_table(struct translator *t, struct syntax_node *n);
+static int expand_field(struct translator *t, struct syntax_node *n);
+
+static int emit_expand(struct translator *t, struct syntax_node *n) {
+	switch(n->type) {
+	case STX_EXPRESSION:
+		return expand_expression(t, n);
+	case STX_VARIABLE:
+		return expand_variable(t, n);
+	case STX_FUNCTIONCALL:
+		return expand_functioncall(t, n);
+	case STX_ARGUMENT:
+		return expand_argument(t, n);
+	case STX_TABLE:
+		return expand_table(t, n);
+	case STX_FIELD:
+		return expand_field(t, n);
+	default:
+		return translate_syntax_node(t, n);
+	}
+}
 
-	fflush(t->fp);
+/* run the stack until the items queued for n are all written */
+static int emit_node(struct translator *t, struct syntax_node *n) {
+	size_t base = t->nitems;
+	emit_push_node(t, n);
+	while(t->nitems > base) {
+		struct emit_item it = t->items[--t->nitems];
+		if(!it.n) {
+			emit_str(t->out, it.s);
+		} else if(!emit_expand(t, it.n)) {
+			t->nitems = base;
+			return 0;
+		}
+	}
+	return 1;
 }
 
 static int trans_syntax_expression(struct translator *t, struct syntax_node *n) {
+	return emit_node(t, n);
+}
+
+static int expand_binary(struct translator *t, struct syntax_node *n, const char *op, const char *end) {
+	if(end) emit_push_str(t, end);
+	emit_push_node(t, n->children->next);
+	emit_push_str(t, op);
+	emit_push_node(t, n->children);
+	return 1;
+}
+
+static int expand_unary(struct translator *t, struct syntax_node *n, const char *op, const char *end) {
+	emit_str(t->out, op);
+	if(end) emit_push_str(t, end);
+	emit_push_node(t, n->children);
+	return 1;
+}
+
+/* parentheses around what needs no grouping in js */
+static int paren_redundant(struct syntax_node *n) {
+	struct syntax_expression *inner = (struct syntax_expression *)n->children;
+	switch(inner->tag) {
+	case EXP_NIL:
+	case EXP_TRUE:
+	case EXP_FALSE:
+	case EXP_STRING:
+	case EXP_VAR:
+	case EXP_FCALL:
+	case EXP_PARENTHESIS:
+	case EXP_DOTS:
+	case EXP_EXP:
+	case EXP_FDIV:
+	case EXP_LEN:
+		return 1;
+	case EXP_FUNC:
+	case EXP_TABLE:
+		return 0;
+	default:
+		break;
+	}
+	//a whole value, not an operand
+	enum syntax_node_type pt = n->parent->type;
+	return pt == STX_STATEMENT || pt == STX_ARGUMENT || pt == STX_FIELD;
+}
+
+static int expand_expression(struct translator *t, struct syntax_node *n) {
 	struct syntax_expression * exp = (struct syntax_expression *)n;
 	log_debug("trans expression %d:%s",
 			 n->lineno,
@@ -617,22 +1584,22 @@ static int trans_syntax_expression(struct translator *t, struct syntax_node *n)
 	case EXP_NIL:
 	case EXP_TRUE:
 	case EXP_FALSE:
-		fprintf(t->fp, " %s ", syntax_expression_tag_string(exp->tag));
+		emit_str(t->out, " ");
+		emit_str(t->out, syntax_expression_tag_string(exp->tag));
+		emit_str(t->out, " ");
 		return 1;
 		
 	case EXP_NUMBER:
 	case EXP_STRING:
-		fprintf(t->fp, "%s", exp->value.string);
+		emit_str(t->out, exp->value.string);
 		return 1;
 		
 	case EXP_PARENTHESIS:
-	{
-		fprintf(t->fp, "( ");
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " )");
-		return 1;
-	}
+		if(fox_options.minify && paren_redundant(n)) {
+			emit_push_node(t, n->children);
+			return 1;
+		}
+		return expand_unary(t, n, "( ", " )");
 
 	case EXP_ADD:
 	case EXP_SUB:
@@ -648,156 +1615,86 @@ static int trans_syntax_expression(struct translator *t, struct syntax_node *n)
 	case EXP_LE:
 	case EXP_GE:
 	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " %s ", syntax_expression_tag_string(exp->tag));
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
+		emit_push_node(t, n->children->next);
+		emit_push_str(t, " ");
+		emit_push_str(t, syntax_expression_tag_string(exp->tag));
+		emit_push_str(t, " ");
+		emit_push_node(t, n->children);
 		return 1;
 	}
 
 	case EXP_EXP:
-	{
-		fprintf(t->fp, "Math.pow(");
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, ", ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-		
-		fprintf(t->fp, ")");
-		return 1;
-	}
+		emit_str(t->out, "Math.pow(");
+		return expand_binary(t, n, ", ", ")");
 	case EXP_FDIV:
-	{
-		fprintf(t->fp, "Math.floor(");
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " / ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;		
-		fprintf(t->fp, ")");
-		return 1;
-	}
-
+		emit_str(t->out, "Math.floor(");
+		return expand_binary(t, n, " / ", ")");
 	case EXP_XOR:
-	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " ^ ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
-		return 1;		
-	}
+		return expand_binary(t, n, " ^ ", NULL);
 	case EXP_EQ:
-	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " === ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
-		return 1;
-	}
+		return expand_binary(t, n, " === ", NULL);
 	case EXP_NE:
-	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " !== ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
-		return 1;
-	}
+		return expand_binary(t, n, " !== ", NULL);
 	case EXP_AND:
-	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " && ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
-		return 1;		
-	}
+		return expand_binary(t, n, " && ", NULL);
 	case EXP_OR:
-	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " || ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
-		return 1;		
-	}
+		return expand_binary(t, n, " || ", NULL);
 	case EXP_CONC:
-	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, " + ");
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
-		return 1;		
-	}
+		emit_str(t->out, "fox.concat(");
+		return expand_binary(t, n, ", ", ")");
 	
 	case EXP_NOT:
-	{	
-		fprintf(t->fp, " !");
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-
-		return 1;	
-	}
+		return expand_unary(t, n, " !", NULL);
 	case EXP_NEG:
-	{
-		fprintf(t->fp, " -");
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-
-		return 1;
-	}
+		return expand_unary(t, n, " -", NULL);
 	case EXP_BNOT:
-	{
-		fprintf(t->fp, " ~");
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-
-		return 1;
-	}
+		return expand_unary(t, n, " ~", NULL);
 	case EXP_LEN:
+		return expand_unary(t, n, "fox.len(", ")");
+
+	case EXP_FCALL:
 	{
-		fprintf(t->fp, "(");
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, ").length ");
+		struct syntax_functioncall *fcall = (struct syntax_functioncall *)n->children;
+		enum call_conv conv = call_conv(fcall);
+		bool all = list_spread(n);
+		if(all && conv == CONV_REGISTER) {
+			//the register is read once the call is done
+			emit_str(t->out, "...[");
+			if(!emit_node(t, n->children)) return 0;
+			for(int i = 1; i < call_nrets(fcall); i++) emit_fmt(t->out, ", rtmp.v%d", i);
+			emit_char(t->out, ']');
+			return 1;
+		}
+		if(all && conv == CONV_ARRAY) {
+			emit_str(t->out, "...");
+		} else if(all && conv == CONV_UNKNOWN) {
+			emit_str(t->out, "...fox.values(");
+			emit_push_str(t, ")");
+		} else if(conv == CONV_ARRAY) {
+			//one value of an array return
+			emit_push_str(t, "[0]");
+		} else if(conv == CONV_UNKNOWN && !ret_passthrough(n)) {
+			emit_str(t->out, "fox.first(");
+			emit_push_str(t, ")");
+		}
+		emit_push_node(t, n->children);
 		return 1;
 	}
-
 	case EXP_TABLE:
-	{
-		return trans_syntax_table(t, n->children);
-	}
 	case EXP_VAR:
-	{
-		return trans_syntax_variable(t, n->children);
-	}
+		emit_push_node(t, n->children);
+		return 1;
 	case EXP_FUNC:
-	{
 		return trans_syntax_function(t, n->children);
-	}
-	case EXP_FCALL:
-	{
-		return trans_syntax_functioncall(t, n->children);
-	}
 
 	case EXP_DOTS:
-	{
-		//can only be used in variable arguments in lua
-		fprintf(t->fp, "arguments");
+		if(!dots_bound(n)) {
+			//the chunk is given no values
+			emit_str(t->out, dots_spread(n) ? "" : " nil ");
+		} else {
+			emit_str(t->out, dots_spread(n) ? "...varargs" : "varargs[0]");
+		}
 		return 1;
-	}
 
 	default:
 		log_assert(FALSE, "unknown expression %d:%d %s",
@@ -809,35 +1706,38 @@ static int trans_syntax_expression(struct translator *t, struct syntax_node *n)
 }
 
 static int trans_syntax_variable(struct translator *t, struct syntax_node *n) {
+	return emit_node(t, n);
+}
+
+static int expand_variable(struct translator *t, struct syntax_node *n) {
 	struct syntax_variable *var = (struct syntax_variable *)n;
-	log_debug("trans variable %d: %d, %s, name:%s",
+	log_debug("trans variable %d: %d, %s, name:%s, %s:%d",
 			 n->lineno,
 			 var->tag,
 			 syntax_variable_tag_string(var->tag),
-			 var->name ? var->name : "");
+			 var->name ? var->name : "",
+			 syntax_binding_string(var->bind),
+			 var->slot);
 	switch(var->tag) {
 	case VAR_NORMAL:
-		fprintf(t->fp, "%s", var->name);
+		emit_str(t->out, var->name);
 		return 1;
 	case VAR_KEY:
 	{
-		int val = trans_syntax_node_children(t, n);
-		if(!val) return 0;
-		fprintf(t->fp, ".");
-		fprintf(t->fp, "%s", var->name);
+		emit_str(t->out, "fox.index(");
+		emit_push_str(t, "\")");
+		emit_push_str(t, var->name);
+		emit_push_str(t, ", \"");
+		emit_push_node(t, n->children);
 		return 1;
 	}
 	case VAR_INDEX:
 	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-
-		fprintf(t->fp, "[");
-		
-		val = trans_syntax_expression(t, n->children->next);
-		if(!val) return 0;
-
-		fprintf(t->fp, "]");
+		emit_str(t->out, "fox.index(");
+		emit_push_str(t, ")");
+		emit_push_node(t, n->children->next);
+		emit_push_str(t, ", ");
+		emit_push_node(t, n->children);
 		return 1;
 	}
 	default:
@@ -849,79 +1749,110 @@ static int trans_syntax_variable(struct translator *t, struct syntax_node *n) {
 	}
 }
 
+/* the table a.b.c:d goes into read through the runtime, returns the last key */
+static const char *emit_func_table(struct fox_output *o, const char *name) {
+	const char *last = name;
+	int depth = 0;
+	for(const char *p = name; *p; p++) {
+		if(*p != '.' && *p != ':') continue;
+		if(last != name) depth++;
+		last = p;
+	}
+	while(depth--) emit_str(o, "fox.index(");
+	const char *p = name;
+	size_t l = strcspn(p, ".:");
+	emit_strn(o, p, l);
+	for(p += l; p < last; p += l) {
+		l = strcspn(++p, ".:");
+		emit_str(o, ", \"");
+		emit_strn(o, p, l);
+		emit_str(o, "\")");
+	}
+	return last + 1;
+}
+
 static int trans_syntax_function(struct translator *t, struct syntax_node *n) {
 	struct syntax_function *func = (struct syntax_function *)n;
 	log_debug("trans function %d, name:%s", n->lineno, func->name ? func->name : "");
 
-	if(func->name) {
-		if((strstr(func->name, ".") || strstr(func->name, ":"))) {
-			char *p = func->name;
-			while(p && *p != '\0') {
-				if(*p == ':') {
-					fputc('.', t->fp);
-				} else {
-					fputc(*p, t->fp);
-				}
-				p++;
-			}
-			fprintf(t->fp, " = function ");
-		} else {
-			fprintf(t->fp, "function %s ", func->name);
-		}
+	bool field = func->name && strpbrk(func->name, ".:");
+	if(field) {
+		emit_str(t->out, "fox.setindex(");
+		const char *key = emit_func_table(t->out, func->name);
+		emit_fmt(t->out, ", \"%s\", function ", key);
+	} else if(func->name) {
+		emit_str(t->out, "function ");
+		emit_str(t->out, func->name);
+		emit_str(t->out, " ");
 	} else {
-		fprintf(t->fp, " function ");
+		emit_str(t->out, " function ");
 	}
 	
-	fprintf(t->fp, "(");
-	if(func_is_method(func->name)) {
-		if(func->pars) {
-			fprintf(t->fp, "self,");
+	//self is the first of the parameters of a method
+	emit_char(t->out, '(');
+	if(func->pars) {
+		const char *dots = strstr(func->pars, "...");
+		if(dots) {
+			emit_strn(t->out, func->pars, dots - func->pars);
+			emit_str(t->out, "...varargs");
 		} else {
-			fprintf(t->fp, "self");
-		}
-	} else {
-		if(func->pars) {
-			char *p = func->pars;
-			while(p && *p != '\0') {
-				//skip variable parameters ...
-				if(*p != '.') {
-					fputc(*p, t->fp);
-				}
-				p++;
-			}
+			emit_str(t->out, func->pars);
 		}
 	}
-	fprintf(t->fp, ")");
+	emit_char(t->out, ')');
 
-	return trans_syntax_block(t, n->children);
+	if(!trans_syntax_block(t, n->children)) return 0;
+	if(field) emit_str(t->out, ")\n");
+	return 1;
 }
 
 static int trans_syntax_functioncall(struct translator *t, struct syntax_node *n) {
+	return emit_node(t, n);
+}
+
+/* o:m(...), a name is read twice, anything else is evaluated once by fox.invoke */
+static int expand_method_call(struct translator *t, struct syntax_node *n, struct syntax_argument *arg) {
+	struct syntax_functioncall *fcall = (struct syntax_functioncall *)n;
+	struct syntax_node *o = n->children;
+	bool name = ((struct syntax_expression *)o)->tag == EXP_VAR
+		&& ((struct syntax_variable *)o->children)->tag == VAR_NORMAL;
+
+	emit_str(t->out, name ? "fox.index(" : "fox.invoke(");
+	emit_push_str(t, ")");
+	emit_push_node(t, &arg->n);
+	if(arg->tag != ARG_EMPTY) emit_push_str(t, ", ");
+	if(name) {
+		emit_push_node(t, o);
+		emit_push_str(t, "\")(");
+	} else {
+		emit_push_str(t, "\"");
+	}
+	emit_push_str(t, fcall->name);
+	emit_push_str(t, ", \"");
+	emit_push_node(t, o);
+	return 1;
+}
+
+static int expand_functioncall(struct translator *t, struct syntax_node *n) {
 	struct syntax_functioncall *fcall = (struct syntax_functioncall *)n;
 	log_debug("trans function call %d", n->lineno);
 	
-	int val = trans_syntax_expression(t, n->children);
-	if(!val) return 0;
-
 	struct syntax_argument *arg = (struct syntax_argument *)n->children->next;
-	
-	fprintf(t->fp, "(");
-	//means method call
-	if(fcall->name) {
-		if(arg->tag == ARG_EMPTY)
-			fprintf(t->fp, "self");
-		else
-			fprintf(t->fp, "self,");
-	}
 
-	val = trans_syntax_argument(t, &arg->n);
-	if(!val) return 0;
+	if(fcall->name) return expand_method_call(t, n, arg);
 
-	fprintf(t->fp, ")");
-	return val;
+	emit_push_str(t, ")");
+	emit_push_node(t, &arg->n);
+	emit_push_str(t, "(");
+	emit_push_node(t, n->children);
+	return 1;
 }
 
 static int trans_syntax_argument(struct translator *t, struct syntax_node *n) {
+	return emit_node(t, n);
+}
+
+static int expand_argument(struct translator *t, struct syntax_node *n) {
 	struct syntax_argument *arg = (struct syntax_argument *)n;
 	log_debug("trans argument %d:%s",
 			 n->lineno,
@@ -930,71 +1861,287 @@ static int trans_syntax_argument(struct translator *t, struct syntax_node *n) {
 	case ARG_EMPTY:
 		return 1;
 	case ARG_NORMAL:
-	{
-		struct syntax_node *c = n->children;
-		while(c) {
-			int val = trans_syntax_expression(t, c);
-			if(!val) return 0;
-			if(c->next) {
-				fprintf(t->fp, ",");
-			}
-			c = c->next;
-		}
+		emit_push_children(t, n, ",");
 		return 1;
-	}
 	case ARG_TABLE:
-		return trans_syntax_table(t, n->children);
+		emit_push_node(t, n->children);
+		return 1;
 	case ARG_STRING:
-		fprintf(t->fp, "%s", arg->name);
+		emit_str(t->out, arg->name);
 		return 1;
 	default:
 		log_assert(FALSE, "unknown argument %d:%d %s",
 				   n->lineno,
 				   arg->tag,
-				   syntax_field_tag_string(arg->tag));
+				   syntax_argument_tag_string(arg->tag));
 		return 0;		
 	}
 }
 
 static int trans_syntax_table(struct translator *t, struct syntax_node *n) {
-	log_debug("trans table %d", n->lineno);
-	if(!n->children) {
-		fprintf(t->fp, "{}");
-		return 1;
+	return emit_node(t, n);
+}
+
+/*
+ * tables made only of literals, numbers, strings, booleans and such
+ * tables, are data. v8 reads a big one much faster from JSON.parse than
+ * from an object literal, so data of fox_options.json_min bytes or more
+ * is written as json straight into the output and fox.data turns what
+ * was parsed into tables. a table is written as
+ * json on the first try, what turns out not to be data or too small is
+ * cut off again, each table keeps its json size so it is tried once.
+ * the json is inside a single quoted js string, every escape is doubled.
+ */
+#define JSON_INT_MAX (1LL << 53)
+
+struct json_frame {
+	struct syntax_node *table;
+	struct syntax_node *field;	/* field holding the table open above */
+	size_t start;				/* output offset of the table */
+};
+
+static void json_push(struct translator *t, struct syntax_node *table, size_t start) {
+	if(t->nframes == t->frames_cap) {
+		t->frames_cap = t->frames_cap ? t->frames_cap * 2 : 16;
+		t->frames = realloc(t->frames, t->frames_cap * sizeof(struct json_frame));
+	}
+	struct json_frame *f = &t->frames[t->nframes++];
+	f->table = table;
+	f->field = NULL;
+	f->start = start;
+}
+
+static struct syntax_node *json_value_node(struct syntax_node *field) {
+	struct syntax_field *f = (struct syntax_field *)field;
+	return f->tag == FIELD_INDEX ? field->children->next : field->children;
+}
+
+/* the table of a table constructor value, NULL for anything else */
+static struct syntax_table *json_nested(struct syntax_node *v) {
+	if(((struct syntax_expression *)v)->tag != EXP_TABLE) return NULL;
+	return (struct syntax_table *)v->children;
+}
+
+/* a string literal as written, 0 if it uses escapes we don't map */
+static int json_emit_string(struct fox_output *o, const char *s) {
+	char q = s[0];
+	emit_char(o, '"');
+	const char *run = s + 1;
+	const char *p = run;
+	for(; p[1] != '\0'; p++) {
+		unsigned char c = *p;
+		if(c >= 0x20 && c != '"' && c != '\\' && c != '\'') continue;
+		if(c == q) return 0;
+		emit_strn(o, run, p - run);
+		if(c == '\\') {
+			c = *++p;
+			switch(c) {
+			case 'n': c = '\n'; break;
+			case 't': c = '\t'; break;
+			case 'r': c = '\r'; break;
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case '\\': case '"': case '\'': case '/': break;
+			default: return 0;
+			}
+		}
+		switch(c) {
+		case '"': emit_str(o, "\\\\\""); break;
+		case '\\': emit_str(o, "\\\\\\\\"); break;
+		case '\'': emit_str(o, "\\'"); break;
+		case '\n': emit_str(o, "\\\\n"); break;
+		case '\t': emit_str(o, "\\\\t"); break;
+		case '\r': emit_str(o, "\\\\r"); break;
+		case '\b': emit_str(o, "\\\\b"); break;
+		case '\f': emit_str(o, "\\\\f"); break;
+		default:
+			if(c < 0x20) {
+				emit_fmt(o, "\\\\u%04x", c);
+			} else {
+				emit_char(o, c);
+			}
+			break;
+		}
+		run = p + 1;
 	}
+	emit_strn(o, run, p - run);
+	emit_char(o, '"');
+	return 1;
+}
 
-	//struct syntax_table *table = (struct syntax_table *)n;
-	struct syntax_field * field = (struct syntax_field *)n->children;
-	if(field->tag == FIELD_KEY) {
-		fprintf(t->fp, "{");
-	} else if(field->tag == FIELD_SINGLE) {
-		fprintf(t->fp, "[");
+/* a decimal numeral json reads as written */
+static int json_numeral(const char *s) {
+	const char *p = s;
+	if(*p == '0') {
+		p++;
 	} else {
-		fprintf(t->fp, "{");
+		if(!isdigit((unsigned char)*p)) return 0;
+		while(isdigit((unsigned char)*p)) p++;
+	}
+	if(*p == '.') {
+		if(!isdigit((unsigned char)*++p)) return 0;
+		while(isdigit((unsigned char)*p)) p++;
+	}
+	if(*p == 'e' || *p == 'E') {
+		p++;
+		if(*p == '+' || *p == '-') p++;
+		if(!isdigit((unsigned char)*p)) return 0;
+		while(isdigit((unsigned char)*p)) p++;
 	}
+	return *p == '\0';
+}
 
-	struct syntax_node *c = n->children;
-	while(c) {
-		int val = trans_syntax_field(t, c);
-		if(!val) return 0;
-		if(c->next) {
-			fprintf(t->fp, ",");
+/* a literal value, 0 if v is not one */
+static int json_emit_literal(struct fox_output *o, struct syntax_node *v) {
+	struct syntax_expression *exp = (struct syntax_expression *)v;
+	if(exp->tag == EXP_NEG) {
+		exp = (struct syntax_expression *)v->children;
+		if(exp->tag != EXP_NUMBER) return 0;
+		emit_char(o, '-');
+	}
+	switch(exp->tag) {
+	case EXP_TRUE:
+		emit_str(o, "true");
+		return 1;
+	case EXP_FALSE:
+		emit_str(o, "false");
+		return 1;
+	case EXP_NUMBER:
+		if(exp->isint) {
+			if(exp->num.integer > JSON_INT_MAX || exp->num.integer < -JSON_INT_MAX) return 0;
+		} else if(!isfinite(exp->num.number)) {
+			return 0;
+		}
+		if(json_numeral(exp->value.string)) {
+			emit_str(o, exp->value.string);
+		} else if(exp->isint) {
+			emit_fmt(o, "%lld", exp->num.integer);
+		} else {
+			char buf[40];
+			emit_strn(o, buf, output_format_double(buf, sizeof(buf), exp->num.number));
 		}
+		return 1;
+	case EXP_STRING:
+		return json_emit_string(o, exp->value.string);
+	default:
+		return 0;
+	}
+}
 
-		c = c->next;
+/* the key of a field, 0 if the field does not fit its table */
+static int json_emit_key(struct fox_output *o, struct syntax_field *f, int array) {
+	if((f->tag == FIELD_SINGLE) != array) return 0;
+	if(f->tag == FIELD_KEY) {
+		//a literal sets the prototype, json makes a property
+		if(!strcmp(f->name, "__proto__")) return 0;
+		emit_char(o, '"');
+		emit_str(o, f->name);
+		emit_str(o, "\":");
+	} else if(f->tag == FIELD_INDEX) {
+		//json keys are strings, a number key would come back as one
+		struct syntax_expression *key = (struct syntax_expression *)f->n.children;
+		if(key->tag == EXP_STRING) {
+			const char *s = key->value.string;
+			if(!strncmp(s + 1, "__proto__", 9) && s[10] == s[0]) return 0;
+			if(!json_emit_string(o, s)) return 0;
+			emit_char(o, ':');
+		} else {
+			return 0;
+		}
 	}
+	return 1;
+}
 
-	if(field->tag == FIELD_KEY) {
-		fprintf(t->fp, "}");
-	} else if(field->tag == FIELD_SINGLE) {
-		fprintf(t->fp, "]");
-	} else {
-		fprintf(t->fp, "}");
+static int json_array(struct syntax_node *table) {
+	struct syntax_field *f = (struct syntax_field *)table->children;
+	return f && f->tag == FIELD_SINGLE;
+}
+
+/* the open tables are not data, drop their frames */
+static int json_fail(struct translator *t, size_t base) {
+	while(t->nframes > base) {
+		((struct syntax_table *)t->frames[--t->nframes].table)->json = TABLE_JSON_NONE;
 	}
+	return 0;
+}
+
+/* write a table as json depth first, 0 if it is not data */
+static int json_emit_table(struct translator *t, struct syntax_node *table) {
+	struct fox_output *o = t->out;
+	size_t base = t->nframes;
+	emit_str(o, "fox.data(JSON.parse('");
+	json_push(t, table, o->len);
+	emit_char(o, json_array(table) ? '[' : '{');
+	struct syntax_node *c = table->children;
+	while(c) {
+		struct syntax_node *p = c->parent;
+		if(!json_emit_key(o, (struct syntax_field *)c, json_array(p))) return json_fail(t, base);
+		struct syntax_node *v = json_value_node(c);
+		struct syntax_table *sub = json_nested(v);
+		if(!sub) {
+			if(!json_emit_literal(o, v)) return json_fail(t, base);
+		} else if(sub->json == TABLE_JSON_NONE) {
+			return json_fail(t, base);
+		} else if(sub->n.children) {
+			t->frames[t->nframes-1].field = c;
+			json_push(t, &sub->n, o->len);
+			emit_char(o, json_array(&sub->n) ? '[' : '{');
+			c = sub->n.children;
+			continue;
+		} else {
+			emit_str(o, "{}");
+			sub->json = 2;
+		}
+		//close the tables finished with this field
+		while(!c->next) {
+			struct json_frame *f = &t->frames[--t->nframes];
+			emit_char(o, json_array(f->table) ? ']' : '}');
+			((struct syntax_table *)f->table)->json = o->len - f->start;
+			if(t->nframes == base) {
+				c = NULL;
+				break;
+			}
+			c = t->frames[t->nframes-1].field;
+		}
+		if(c) {
+			emit_char(o, ',');
+			c = c->next;
+		}
+	}
+	emit_str(o, "'))");
+	return 1;
+}
+
+static int expand_table(struct translator *t, struct syntax_node *n) {
+	log_debug("trans table %d", n->lineno);
+	struct syntax_table *table = (struct syntax_table *)n;
+	if(fox_options.json_min && n->children && table->json != TABLE_JSON_NONE
+	   && (table->json == TABLE_JSON_UNKNOWN || table->json >= fox_options.json_min)) {
+		size_t mark = t->out->len;
+		if(json_emit_table(t, n) && table->json >= fox_options.json_min) return 1;
+		output_truncate(t->out, mark);
+	}
+
+	//the array part, then the other keys and values in turn
+	bool keyed = FALSE;
+	for(struct syntax_node *c = n->children; c; c = c->next) {
+		if(((struct syntax_field *)c)->tag != FIELD_SINGLE) keyed = TRUE;
+	}
+	emit_str(t->out, "fox.table([");
+	emit_push_str(t, "])");
+	if(keyed) {
+		emit_push_fields(t, n, FALSE, ", ");
+		emit_push_str(t, "], [");
+	}
+	emit_push_fields(t, n, TRUE, ",");
 	return 1;
 }
 
 static int trans_syntax_field(struct translator *t, struct syntax_node *n) {
+	return emit_node(t, n);
+}
+
+static int expand_field(struct translator *t, struct syntax_node *n) {
 	struct syntax_field *field = (struct syntax_field *)n;
 	log_debug("trans field, %d:%s, name:%s",
 			 n->lineno,
@@ -1003,19 +2150,20 @@ static int trans_syntax_field(struct translator *t, struct syntax_node *n) {
 	switch(field->tag) {
 	case FIELD_INDEX:
 	{
-		int val = trans_syntax_expression(t, n->children);
-		if(!val) return 0;
-		fprintf(t->fp, ": ");
-		return trans_syntax_expression(t, n->children->next);
+		emit_push_node(t, n->children->next);
+		emit_push_str(t, ", ");
+		emit_push_node(t, n->children);
+		return 1;
 	}
 	case FIELD_KEY:
 	{
-		fprintf(t->fp, "%s", field->name);
-		fprintf(t->fp, ": ");
-		return trans_syntax_expression(t, n->children);
+		emit_fmt(t->out, "\"%s\", ", field->name);
+		emit_push_node(t, n->children);
+		return 1;
 	}
 	case FIELD_SINGLE:
-		return trans_syntax_expression(t, n->children);
+		emit_push_node(t, n->children);
+		return 1;
 	default:
 		log_assert(FALSE, "unknown field %d:%d %s",
 				   n->lineno,
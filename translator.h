@@ -1,7 +1,36 @@
 #ifndef __TRANSLATOR_H__
 #define __TRANSLATOR_H__
 
+#include <stddef.h>
+
+struct fox_output;
+struct fox_source;
+struct syntax_tree;
+struct syntax_chunk;
+struct syntax_functioncall;
+struct symbol_table;
+struct fox_stats;
+
+/* per-parse state shared by the reentrant lexer and parser */
+struct parse_context {
+	const char *filename;
+	struct syntax_tree *tree;
+	struct symbol_table *table;
+	struct fox_stats *stats;	/* NULL unless stats are collected */
+};
+
 int parse(const char *filename, struct syntax_tree **tree, struct symbol_table **table);
+int parse_source(const char *name, struct fox_source *src, struct syntax_tree **tree, struct symbol_table **table);
+int parse_source_stats(const char *name, struct fox_source *src, struct syntax_tree **tree, struct symbol_table **table, struct fox_stats *stats);
+int parse_tree(const char *name, struct fox_source *src, struct syntax_tree **tree, struct symbol_table **table);
+int parse_buffer(const char *name, const char *src, size_t len, struct syntax_tree **tree, struct symbol_table **table);
+/* a call of a runtime library function known to give one value */
+int call_lib_single(struct syntax_functioncall *fcall);
+void gen_chunk_symtables(struct syntax_tree *t, struct syntax_chunk *chunk);
+void fold_chunk_constants(struct syntax_tree *t, struct syntax_chunk *chunk);
 int translate(const char *filename, struct syntax_tree *tree, struct symbol_table *table);
+int translate_output(struct fox_output *out, struct syntax_tree *tree, struct symbol_table *table);
+/* translate_output, the module requires the runtime from that path */
+int translate_output_runtime(struct fox_output *out, struct syntax_tree *tree, struct symbol_table *table, const char *runtime);
 
 #endif